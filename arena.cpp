@@ -0,0 +1,28 @@
+#include "arena.h"
+
+namespace runtime
+{
+
+    namespace
+    {
+        thread_local std::pmr::memory_resource *current_resource = nullptr;
+    } // namespace
+
+    Arena::Arena()
+        : resource_(INITIAL_BLOCK_SIZE){
+    }
+
+    ArenaScope::ArenaScope(Arena &arena)
+        : previous_(current_resource){
+        current_resource = arena.GetResource();
+    }
+
+    ArenaScope::~ArenaScope(){
+        current_resource = previous_;
+    }
+
+    std::pmr::memory_resource *CurrentResource(){
+        return current_resource != nullptr ? current_resource : std::pmr::new_delete_resource();
+    }
+
+} // namespace runtime
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+
+namespace runtime
+{
+
+    // Область памяти для узлов дерева программы и их контейнеров.
+    // Память выделяется сдвигом указателя внутри крупных блоков, поэтому соседние узлы
+    // лежат в памяти рядом, а освобождение отдельных узлов ничего не стоит.
+    // Все блоки возвращаются системе разом при уничтожении арены
+    class Arena{
+    public:
+        Arena();
+
+        Arena(const Arena &) = delete;
+        Arena &operator=(const Arena &) = delete;
+
+        [[nodiscard]] std::pmr::memory_resource *GetResource(){
+            return &resource_;
+        }
+
+    private:
+        static constexpr size_t INITIAL_BLOCK_SIZE = 64 * 1024;
+
+        std::pmr::monotonic_buffer_resource resource_;
+    };
+
+    // Пока объект ArenaScope существует, узлы Executable, создаваемые в текущем потоке,
+    // и их контейнеры размещаются в арене arena
+    class ArenaScope{
+    public:
+        explicit ArenaScope(Arena &arena);
+        ~ArenaScope();
+
+        ArenaScope(const ArenaScope &) = delete;
+        ArenaScope &operator=(const ArenaScope &) = delete;
+
+    private:
+        std::pmr::memory_resource *previous_;
+    };
+
+    // Возвращает арену текущей области ArenaScope либо обычную кучу, если область не задана
+    std::pmr::memory_resource *CurrentResource();
+
+} // namespace runtime
@@ -0,0 +1,689 @@
+#include "bytecode.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iterator>
+#include <stdexcept>
+#include <string_view>
+
+// Команды выбираются переходом по таблице адресов меток (расширение GCC и Clang):
+// у каждой команды свой косвенный переход, который предсказывается отдельно.
+// Остальные компиляторы, а также сборка с MYTHON_NO_COMPUTED_GOTO, используют switch
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(MYTHON_NO_COMPUTED_GOTO)
+#define MYTHON_COMPUTED_GOTO 1
+#endif
+
+using namespace std;
+
+namespace bytecode
+{
+
+    namespace
+    {
+        const symbols::Symbol INIT_METHOD = "__init__"sv;
+        const symbols::Symbol STR_METHOD = "__str__"sv;
+        const symbols::Symbol ADD_METHOD = "__add__"sv;
+        const symbols::Symbol SELF = "self"sv;
+
+        // Компилирует каждое выражение в заданный регистр dst. Временные значения
+        // занимают регистры выше dst и освобождаются сразу после использования
+        class Compiler final : public ast::StatementVisitor{
+        public:
+            Chunk Compile(runtime::Executable &statement){
+                const uint32_t result = AllocateRegister();
+                if (const auto *body = dynamic_cast<const ast::MethodBody *>(&statement)){
+                    chunk_.is_method_body = true;
+                    CompileTo(body->GetBody(), result);
+                    Emit(OpCode::LoadNone, result);
+                }else{
+                    CompileTo(statement, result);
+                }
+                Emit(OpCode::Return, result);
+                return std::move(chunk_);
+            }
+
+            void Visit(const ast::NumericConst &node) override{
+                EmitConst(node.GetConstant());
+            }
+
+            void Visit(const ast::StringConst &node) override{
+                EmitConst(node.GetConstant());
+            }
+
+            void Visit(const ast::BoolConst &node) override{
+                EmitConst(node.GetConstant());
+            }
+
+            void Visit(const ast::VariableValue &node) override{
+                const ast::SymbolList &ids = node.GetDottedIds();
+                const bool local = node.GetSlot() != ast::NO_SLOT;
+                if (ids.size() == 1){
+                    if (local){
+                        Emit(OpCode::LoadLocal, dst_, node.GetSlot());
+                    }else{
+                        Emit(OpCode::LoadName, dst_, ids.front().GetId());
+                    }
+                    return;
+                }
+                if (local){
+                    Emit(OpCode::LoadLocalRoot, dst_, node.GetSlot());
+                }else{
+                    Emit(OpCode::LoadRoot, dst_, ids.front().GetId());
+                }
+                for (size_t i = 1; i + 1 < ids.size(); ++i){
+                    Emit(OpCode::LoadInnerField, dst_, AddFieldCache(ids[i]));
+                }
+                Emit(OpCode::LoadField, dst_, AddFieldCache(ids.back()));
+            }
+
+            void Visit(const ast::Assignment &node) override{
+                const uint32_t dst = dst_;
+                CompileTo(node.GetExpression(), dst);
+                if (node.GetSlot() != ast::NO_SLOT){
+                    Emit(OpCode::StoreLocal, dst, 0, node.GetSlot());
+                }else{
+                    Emit(OpCode::StoreName, dst, 0, node.GetName().GetId());
+                }
+            }
+
+            void Visit(const ast::FieldAssignment &node) override{
+                const uint32_t dst = dst_;
+                const uint32_t mark = next_register_;
+                const uint32_t object = AllocateRegister();
+                CompileTo(node.GetObject(), object);
+                Emit(OpCode::CheckInstance, object);
+                CompileTo(node.GetExpression(), dst);
+                Emit(OpCode::StoreField, dst, object, AddFieldCache(node.GetFieldName()));
+                next_register_ = mark;
+            }
+
+            void Visit(const ast::None & /*node*/) override{
+                Emit(OpCode::LoadNone, dst_);
+            }
+
+            void Visit(const ast::Print &node) override{
+                // Каждый аргумент выводится сразу после вычисления, как при обходе дерева
+                const uint32_t dst = dst_;
+                uint32_t position = 0;
+                for (const auto &arg : node.GetArgs()){
+                    CompileTo(*arg, dst);
+                    Emit(OpCode::PrintValue, dst, AddMethodCache(STR_METHOD), 0, position);
+                    position = 1;
+                }
+                Emit(OpCode::PrintEnd, dst);
+            }
+
+            void Visit(const ast::MethodCall &node) override{
+                const uint32_t dst = dst_;
+                const uint32_t mark = next_register_;
+                const uint32_t first = CompileArgs(node.GetArgs());
+                CompileTo(node.GetObject(), AllocateRegister());
+                Emit(OpCode::CallMethod, dst, first, AddMethodCache(node.GetMethod()), GetCount(node.GetArgs()));
+                next_register_ = mark;
+            }
+
+            void Visit(const ast::NewInstance &node) override{
+                const uint32_t dst = dst_;
+                Emit(OpCode::NewInstance, dst, static_cast<uint32_t>(chunk_.classes.size()));
+                chunk_.classes.push_back(&node.GetClass());
+                // Аргументы вычисляются, только если подходящий __init__ есть
+                const uint32_t init_cache = AddMethodCache(INIT_METHOD);
+                const size_t skip = Emit(OpCode::InitOrSkip, dst, 0, init_cache, GetCount(node.GetArgs()));
+                const uint32_t mark = next_register_;
+                const uint32_t first = CompileArgs(node.GetArgs());
+                Emit(OpCode::CallInit, dst, first, init_cache, GetCount(node.GetArgs()));
+                next_register_ = mark;
+                Patch(skip);
+            }
+
+            void Visit(const ast::Stringify &node) override{
+                EmitUnary(*node.GetArg(), OpCode::Stringify, AddMethodCache(STR_METHOD));
+            }
+
+            void Visit(const ast::Add &node) override{
+                EmitBinary(node, OpCode::Add, AddMethodCache(ADD_METHOD));
+            }
+
+            void Visit(const ast::Sub &node) override{
+                EmitBinary(node, OpCode::Sub);
+            }
+
+            void Visit(const ast::Mult &node) override{
+                EmitBinary(node, OpCode::Mult);
+            }
+
+            void Visit(const ast::Div &node) override{
+                EmitBinary(node, OpCode::Div);
+            }
+
+            void Visit(const ast::Or &node) override{
+                EmitShortCircuit(node, OpCode::JumpIfTrue);
+            }
+
+            void Visit(const ast::And &node) override{
+                EmitShortCircuit(node, OpCode::JumpIfFalse);
+            }
+
+            void Visit(const ast::Not &node) override{
+                EmitUnary(*node.GetArg(), OpCode::Not);
+            }
+
+            void Visit(const ast::Compound &node) override{
+                const uint32_t dst = dst_;
+                for (const auto &statement : node.GetStatements()){
+                    CompileTo(*statement, dst);
+                }
+                Emit(OpCode::LoadNone, dst);
+            }
+
+            void Visit(const ast::MethodBody &node) override{
+                // Тело метода внутри другой инструкции встречается только в деревьях,
+                // собранных вручную, и выполняется обходом дерева
+                VisitOpaque(node);
+            }
+
+            void Visit(const ast::Return &node) override{
+                const uint32_t dst = dst_;
+                CompileTo(node.GetStatement(), dst);
+                Emit(chunk_.is_method_body ? OpCode::Return : OpCode::PropagateReturn, dst);
+            }
+
+            void Visit(const ast::ClassDefinition &node) override{
+                Emit(OpCode::DefineClass, dst_, static_cast<uint32_t>(chunk_.constants.size()));
+                chunk_.constants.push_back(node.GetClass());
+            }
+
+            void Visit(const ast::IfElse &node) override{
+                const uint32_t dst = dst_;
+                CompileTo(node.GetCondition(), dst);
+                const size_t to_else = Emit(OpCode::JumpIfFalse, dst);
+                CompileTo(node.GetIfBody(), dst);
+                const size_t to_end = Emit(OpCode::Jump);
+                Patch(to_else);
+                if (const ast::Statement *else_body = node.GetElseBody()){
+                    CompileTo(*else_body, dst);
+                }else{
+                    Emit(OpCode::LoadNone, dst);
+                }
+                Patch(to_end);
+            }
+
+            void Visit(const ast::Comparison &node) override{
+                const auto comparison = static_cast<uint32_t>(chunk_.comparisons.size());
+                chunk_.comparisons.push_back(ComparisonSite{&node.GetComparator(), node.GetCachedComparator(), {}});
+                EmitBinary(node, OpCode::Compare, comparison);
+            }
+
+            void VisitOpaque(const ast::Statement &node) override{
+                Emit(OpCode::Execute, dst_, static_cast<uint32_t>(chunk_.statements.size()));
+                // Обходчик получает узлы только для чтения, а Execute не константен.
+                // Сама программа, которую выполняет машина, изменяемая
+                chunk_.statements.push_back(const_cast<ast::Statement *>(&node));
+            }
+
+        private:
+            Chunk chunk_;
+            // Регистр для результата компилируемого узла
+            uint32_t dst_ = 0;
+            uint32_t next_register_ = 0;
+
+            static uint32_t GetCount(const ast::StatementList &args){
+                return static_cast<uint32_t>(args.size());
+            }
+
+            uint32_t AllocateRegister(){
+                chunk_.register_count = std::max<size_t>(chunk_.register_count, next_register_ + 1);
+                return next_register_++;
+            }
+
+            void CompileTo(const ast::Statement &node, uint32_t dst){
+                const uint32_t saved = dst_;
+                dst_ = dst;
+                node.Accept(*this);
+                dst_ = saved;
+            }
+
+            // Вычисляет аргументы в подряд идущие регистры и возвращает номер первого из них
+            uint32_t CompileArgs(const ast::StatementList &args){
+                const uint32_t first = next_register_;
+                for (const auto &arg : args){
+                    CompileTo(*arg, AllocateRegister());
+                }
+                return first;
+            }
+
+            size_t Emit(OpCode op, uint32_t dst = 0, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0){
+                chunk_.code.push_back(Instruction{op, c, dst, a, b});
+                return chunk_.code.size() - 1;
+            }
+
+            // Направляет переход, записанный командой jump, на следующую команду
+            void Patch(size_t jump){
+                chunk_.code[jump].a = static_cast<uint32_t>(chunk_.code.size());
+            }
+
+            void EmitConst(runtime::ObjectHolder value){
+                Emit(OpCode::LoadConst, dst_, static_cast<uint32_t>(chunk_.constants.size()));
+                chunk_.constants.push_back(std::move(value));
+            }
+
+            // Заводит кеш для отдельного места вызова метода name и возвращает его номер
+            uint32_t AddMethodCache(symbols::Symbol name){
+                chunk_.method_caches.emplace_back(name);
+                return static_cast<uint32_t>(chunk_.method_caches.size() - 1);
+            }
+
+            // Заводит кеш для отдельного места обращения к полю name и возвращает его номер
+            uint32_t AddFieldCache(symbols::Symbol name){
+                chunk_.field_caches.emplace_back(name);
+                return static_cast<uint32_t>(chunk_.field_caches.size() - 1);
+            }
+
+            void EmitUnary(const ast::Statement &arg, OpCode op, uint32_t b = 0){
+                const uint32_t dst = dst_;
+                CompileTo(arg, dst);
+                Emit(op, dst, dst, b);
+            }
+
+            void EmitBinary(const ast::BinaryOperation &node, OpCode op, uint32_t c = 0){
+                const uint32_t dst = dst_;
+                const uint32_t mark = next_register_;
+                CompileTo(*node.GetLhs(), dst);
+                const uint32_t rhs = AllocateRegister();
+                CompileTo(*node.GetRhs(), rhs);
+                Emit(op, dst, dst, rhs, c);
+                next_register_ = mark;
+            }
+
+            void EmitShortCircuit(const ast::BinaryOperation &node, OpCode jump_op){
+                const uint32_t dst = dst_;
+                CompileTo(*node.GetLhs(), dst);
+                const size_t jump = Emit(jump_op, dst);
+                CompileTo(*node.GetRhs(), dst);
+                Patch(jump);
+            }
+        };
+
+    } // namespace
+
+    Chunk Compile(runtime::Executable &statement){
+        return Compiler().Compile(statement);
+    }
+
+    VirtualMachine::VirtualMachine(runtime::Context &context)
+        : context_(context){
+    }
+
+    runtime::ObjectHolder VirtualMachine::Execute(runtime::Executable &statement, runtime::Closure &closure){
+        auto it = chunks_.find(&statement);
+        if (it == chunks_.end()){
+            it = chunks_.emplace(&statement, Compile(statement)).first;
+        }
+        Chunk &chunk = it->second;
+
+        const size_t frame = registers_.size();
+        registers_.resize(frame + chunk.register_count);
+        try{
+            return Run(chunk, closure, frame);
+        }catch (...){
+            registers_.resize(frame);
+            throw;
+        }
+    }
+
+    runtime::ObjectHolder VirtualMachine::Run(Chunk &chunk, runtime::Closure &closure, size_t frame){
+        using runtime::ClassInstance;
+        using runtime::ObjectHolder;
+
+        const Instruction *const code = chunk.code.data();
+        const Instruction *instruction = code;
+        // Вложенные вызовы дописывают свои кадры в registers_ и могут переместить его,
+        // поэтому после них указатель на кадр получается заново
+        ObjectHolder *registers = registers_.data() + frame;
+
+#ifdef MYTHON_COMPUTED_GOTO
+        static const void *const DISPATCH_TABLE[] = {
+            &&LoadConst, &&LoadNone, &&LoadName, &&LoadRoot, &&LoadLocal, &&LoadLocalRoot,
+            &&LoadInnerField, &&LoadField, &&StoreName, &&StoreLocal, &&CheckInstance, &&StoreField, &&PrintValue, &&PrintEnd, &&CallMethod,
+            &&NewInstance, &&InitOrSkip, &&CallInit, &&Stringify, &&Add, &&Sub, &&Mult, &&Div,
+            &&Not, &&Compare, &&Jump, &&JumpIfFalse, &&JumpIfTrue, &&DefineClass, &&Return,
+            &&PropagateReturn, &&Execute,
+        };
+        static_assert(std::size(DISPATCH_TABLE) == OPCODE_COUNT);
+
+        // Переход goto по адресу не вызывает деструкторы локальных объектов блока, из которого
+        // он выполняется, поэтому такие объекты команда держит во вложенном блоке до VM_NEXT
+#define VM_CASE(name) name
+#define VM_NEXT() goto *DISPATCH_TABLE[static_cast<size_t>(instruction->op)]
+#define VM_JUMP(target)                                                       \
+    {                                                                         \
+        instruction = code + (target);                                        \
+        VM_NEXT();                                                            \
+    }
+
+        VM_NEXT();
+#else
+#define VM_CASE(name) case OpCode::name
+#define VM_NEXT() break
+#define VM_JUMP(target)                                                       \
+    {                                                                         \
+        instruction = code + (target);                                        \
+        break;                                                                \
+    }
+
+        for (;;){
+            switch (instruction->op){
+#endif
+
+        VM_CASE(LoadConst):
+            registers[instruction->dst] = chunk.constants[instruction->a];
+            ++instruction;
+            VM_NEXT();
+
+        VM_CASE(LoadNone):
+            registers[instruction->dst] = ObjectHolder::None();
+            ++instruction;
+            VM_NEXT();
+
+        VM_CASE(LoadName):{
+            const auto it = closure.find(symbols::Symbol::FromId(instruction->a));
+            if (it == closure.end()){
+                throw std::runtime_error("ERROR: Unknown name"s);
+            }
+            registers[instruction->dst] = it->second;
+            ++instruction;
+            VM_NEXT();
+        }
+
+        VM_CASE(LoadRoot):{
+            {
+                ObjectHolder object = closure.at(symbols::Symbol::FromId(instruction->a));
+                if (!object.TryAs<ClassInstance>()){
+                    throw std::runtime_error("ERROR:The object is not a class"s);
+                }
+                registers[instruction->dst] = std::move(object);
+            }
+            ++instruction;
+            VM_NEXT();
+        }
+
+        VM_CASE(LoadLocal):{
+            const runtime::LocalSlot &local = context_.GetLocals()[instruction->a];
+            if (!local){
+                throw std::runtime_error("ERROR: Unknown name"s);
+            }
+            registers[instruction->dst] = *local;
+            ++instruction;
+            VM_NEXT();
+        }
+
+        VM_CASE(LoadLocalRoot):{
+            const runtime::LocalSlot &local = context_.GetLocals()[instruction->a];
+            if (!local){
+                throw std::out_of_range("ERROR: Unknown name"s);
+            }
+            if (!local->TryAs<ClassInstance>()){
+                throw std::runtime_error("ERROR:The object is not a class"s);
+            }
+            registers[instruction->dst] = *local;
+            ++instruction;
+            VM_NEXT();
+        }
+
+        VM_CASE(LoadInnerField):{
+            ObjectHolder &object = registers[instruction->dst];
+            const ObjectHolder *field =
+                chunk.field_caches[instruction->a].Find(object.TryAs<ClassInstance>()->Fields());
+            if (field == nullptr){
+                throw std::runtime_error("ERROR:Accessing a non-existent field"s);
+            }
+            if (!field->TryAs<ClassInstance>()){
+                throw std::runtime_error("ERROR:The object is not a class"s);
+            }
+            object = ObjectHolder(*field);
+            ++instruction;
+            VM_NEXT();
+        }
+
+        VM_CASE(LoadField):{
+            ObjectHolder &object = registers[instruction->dst];
+            const ObjectHolder *field =
+                chunk.field_caches[instruction->a].Find(object.TryAs<ClassInstance>()->Fields());
+            if (field == nullptr){
+                throw std::runtime_error("ERROR: Unknown name"s);
+            }
+            object = ObjectHolder(*field);
+            ++instruction;
+            VM_NEXT();
+        }
+
+        VM_CASE(StoreName):
+            closure.insert_or_assign(symbols::Symbol::FromId(instruction->b), registers[instruction->dst]);
+            ++instruction;
+            VM_NEXT();
+
+        VM_CASE(StoreLocal):
+            context_.GetLocals()[instruction->b] = registers[instruction->dst];
+            ++instruction;
+            VM_NEXT();
+
+        VM_CASE(CheckInstance):
+            if (!registers[instruction->dst].TryAs<ClassInstance>()){
+                throw std::runtime_error("ERROR:attempt to access a non-instance class field"s);
+            }
+            ++instruction;
+            VM_NEXT();
+
+        VM_CASE(StoreField):
+            chunk.field_caches[instruction->b].Get(registers[instruction->a].TryAs<ClassInstance>()->Fields()) =
+                registers[instruction->dst];
+            ++instruction;
+            VM_NEXT();
+
+        VM_CASE(PrintValue):{
+            const ObjectHolder &value = registers[instruction->dst];
+            std::ostream &output = context_.GetOutputStream();
+            if (instruction->c != 0){
+                output << ' ';
+            }
+            runtime::PrintValue(value, output, context_, chunk.method_caches[instruction->a]);
+            ++instruction;
+            VM_NEXT();
+        }
+
+        VM_CASE(PrintEnd):
+            context_.GetOutputStream() << "\n";
+            registers[instruction->dst] = ObjectHolder::None();
+            ++instruction;
+            VM_NEXT();
+
+        VM_CASE(CallMethod):{
+            {
+                // Объект остаётся жив до конца вызова, даже если метод перезапишет все ссылки на него
+                const ObjectHolder object = std::move(registers[instruction->a + instruction->c]);
+                auto *instance = object.TryAs<ClassInstance>();
+                if (!instance){
+                    throw std::runtime_error("ERROR:the object is not a class"s);
+                }
+                const runtime::Method *method =
+                    chunk.method_caches[instruction->b].Find(instance->GetClass(), instruction->c);
+                if (method == nullptr){
+                    throw std::runtime_error("ERROR:Такого метода не существует"s);
+                }
+                ObjectHolder result = CallMethod(*instance, *method, frame + instruction->a, instruction->c);
+                registers = registers_.data() + frame;
+                registers[instruction->dst] = std::move(result);
+            }
+            ++instruction;
+            VM_NEXT();
+        }
+
+        VM_CASE(NewInstance):
+            registers[instruction->dst] = ObjectHolder::Own(ClassInstance(*chunk.classes[instruction->a]));
+            ++instruction;
+            VM_NEXT();
+
+        VM_CASE(InitOrSkip):
+            if (chunk.method_caches[instruction->b].Find(registers[instruction->dst].TryAs<ClassInstance>()->GetClass(),
+                                                         instruction->c) == nullptr){
+                VM_JUMP(instruction->a);
+            }
+            ++instruction;
+            VM_NEXT();
+
+        VM_CASE(CallInit):{
+            {
+                auto &instance = *registers[instruction->dst].TryAs<ClassInstance>();
+                const runtime::Method &init = *chunk.method_caches[instruction->b].Find(instance.GetClass(), instruction->c);
+                CallMethod(instance, init, frame + instruction->a, instruction->c);
+            }
+            registers = registers_.data() + frame;
+            ++instruction;
+            VM_NEXT();
+        }
+
+        VM_CASE(Stringify):
+            registers[instruction->dst] = ast::Stringify::Apply(registers[instruction->a], context_,
+                                                                chunk.method_caches[instruction->b]);
+            ++instruction;
+            VM_NEXT();
+
+        VM_CASE(Add):
+            registers[instruction->dst] = ast::Add::Apply(registers[instruction->a], registers[instruction->b],
+                                                          context_, chunk.method_caches[instruction->c]);
+            ++instruction;
+            VM_NEXT();
+
+        VM_CASE(Sub):
+            registers[instruction->dst] = ast::Sub::Apply(registers[instruction->a], registers[instruction->b]);
+            ++instruction;
+            VM_NEXT();
+
+        VM_CASE(Mult):
+            registers[instruction->dst] = ast::Mult::Apply(registers[instruction->a], registers[instruction->b]);
+            ++instruction;
+            VM_NEXT();
+
+        VM_CASE(Div):
+            registers[instruction->dst] = ast::Div::Apply(registers[instruction->a], registers[instruction->b]);
+            ++instruction;
+            VM_NEXT();
+
+        VM_CASE(Not):
+            registers[instruction->dst] = ast::Not::Apply(registers[instruction->a]);
+            ++instruction;
+            VM_NEXT();
+
+        VM_CASE(Compare):{
+            ComparisonSite &site = chunk.comparisons[instruction->c];
+            const bool result = site.cached
+                ? (site.caches.*site.cached)(registers[instruction->a], registers[instruction->b], context_)
+                : (*site.comparator)(registers[instruction->a], registers[instruction->b], context_);
+            registers[instruction->dst] = ObjectHolder::Own(runtime::Bool(result));
+            ++instruction;
+            VM_NEXT();
+        }
+
+        VM_CASE(Jump):
+            VM_JUMP(instruction->a);
+
+        VM_CASE(JumpIfFalse):
+            if (!ast::IsConditionTrue(registers[instruction->dst])){
+                VM_JUMP(instruction->a);
+            }
+            ++instruction;
+            VM_NEXT();
+
+        VM_CASE(JumpIfTrue):
+            if (ast::IsConditionTrue(registers[instruction->dst])){
+                VM_JUMP(instruction->a);
+            }
+            ++instruction;
+            VM_NEXT();
+
+        VM_CASE(DefineClass):{
+            const ObjectHolder &cls = chunk.constants[instruction->a];
+            closure[symbols::Symbol(cls.TryAs<runtime::Class>()->GetName())] = cls;
+            registers[instruction->dst] = cls;
+            ++instruction;
+            VM_NEXT();
+        }
+
+        VM_CASE(Return):{
+            ObjectHolder result = std::move(registers[instruction->dst]);
+            registers_.resize(frame);
+            return result;
+        }
+
+        VM_CASE(PropagateReturn):{
+            ObjectHolder result = std::move(registers[instruction->dst]);
+            context_.BeginReturn();
+            registers_.resize(frame);
+            return result;
+        }
+
+        VM_CASE(Execute):
+            registers[instruction->dst] = chunk.statements[instruction->a]->Execute(closure, context_);
+            if (context_.IsReturning()){
+                // Инструкция выполнила return: тело метода завершает возврат,
+                // остальные фрагменты передают его наверх, как ast::Compound
+                if (chunk.is_method_body){
+                    context_.EndReturn();
+                }
+                ObjectHolder result = std::move(registers[instruction->dst]);
+                registers_.resize(frame);
+                return result;
+            }
+            ++instruction;
+            VM_NEXT();
+
+#ifndef MYTHON_COMPUTED_GOTO
+            }
+        }
+#endif
+
+#undef VM_CASE
+#undef VM_NEXT
+#undef VM_JUMP
+    }
+
+    runtime::ObjectHolder VirtualMachine::CallMethod(runtime::ClassInstance &instance, const runtime::Method &method,
+                                                     size_t first_arg, size_t argument_count){
+        if (method.local_count != 0){
+            runtime::CallArguments args(context_, argument_count);
+            for (size_t i = 0; i < argument_count; ++i){
+                args[i] = std::move(registers_[first_arg + i]);
+            }
+            const runtime::MethodFrame frame(method, instance, args, context_);
+            runtime::Closure unused;
+            return Execute(*method.body, unused);
+        }
+        runtime::Closure args;
+        args[SELF] = runtime::ObjectHolder::Share(instance);
+        for (size_t i = 0; i < argument_count; ++i){
+            args[method.formal_params[i]] = std::move(registers_[first_arg + i]);
+        }
+        return Execute(*method.body, args);
+    }
+
+    Engine GetEngineFromEnvironment(){
+        const char *engine = getenv("MYTHON_ENGINE");
+        if (engine == nullptr || *engine == '\0' || engine == "tree"sv){
+            return Engine::Tree;
+        }
+        if (engine == "bytecode"sv){
+            return Engine::Bytecode;
+        }
+        throw std::invalid_argument("ERROR:unknown MYTHON_ENGINE "s + engine);
+    }
+
+    runtime::ObjectHolder ExecuteProgram(runtime::Executable &program, runtime::Closure &closure,
+                                         runtime::Context &context, Engine engine){
+        runtime::ObjectHolder result = engine == Engine::Tree ? program.Execute(closure, context)
+                                                              : VirtualMachine(context).Execute(program, closure);
+        // return вне метода завершает только эту программу
+        context.EndReturn();
+        return result;
+    }
+
+} // namespace bytecode
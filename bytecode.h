@@ -0,0 +1,137 @@
+#pragma once
+
+#include "runtime.h"
+#include "statement.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace bytecode
+{
+
+    // Команды регистровой машины. Операнды dst, a и b — номера регистров кадра,
+    // если не сказано иное; c — число аргументов или номер компаратора
+    enum class OpCode : uint8_t{
+        LoadConst,       // dst = константа a
+        LoadNone,        // dst = None
+        LoadName,        // dst = переменная a из closure
+        LoadRoot,        // первое имя цепочки x.y.z: dst = переменная a, которая должна быть объектом
+        LoadLocal,       // dst = локальная переменная из слота a кадра метода
+        LoadLocalRoot,   // как LoadRoot, но первое имя цепочки — локальная переменная из слота a
+        LoadInnerField,  // промежуточное поле цепочки: dst = dst.f, где f — поле кеша a, значение должно быть объектом
+        LoadField,       // последнее поле цепочки: dst = dst.f, где f — поле кеша a
+        StoreName,       // переменная b из closure = dst
+        StoreLocal,      // локальная переменная из слота b = dst
+        CheckInstance,   // проверяет, что в dst объект, полю которого присваивается значение
+        StoreField,      // a.f = dst, где a — объект, а f — поле кеша b
+        PrintValue,      // выводит dst, ища __str__ через кеш a; c == 0 для первого аргумента print
+        PrintEnd,        // завершает строку print, dst = None
+        CallMethod,      // dst = a[c].m(a[0], ..., a[c - 1]), где m — метод из кеша b: аргументы и объект лежат в регистрах подряд
+        NewInstance,     // dst = новый экземпляр класса a
+        InitOrSkip,      // если у dst нет __init__ с c параметрами, переходит на команду a; b — номер кеша __init__
+        CallInit,        // вызывает dst.__init__(a[0], ..., a[c - 1]), найденный по кешу b
+        Stringify,       // dst = str(a), __str__ ищется через кеш b
+        Add,             // dst = a + b, __add__ ищется через кеш c
+        Sub,             // dst = a - b
+        Mult,            // dst = a * b
+        Div,             // dst = a / b
+        Not,             // dst = not a
+        Compare,         // dst = сравнение c (a, b)
+        Jump,            // переходит на команду a
+        JumpIfFalse,     // переходит на команду a, если dst ложно
+        JumpIfTrue,      // переходит на команду a, если dst истинно
+        DefineClass,     // сохраняет класс-константу a в closure, dst = класс
+        Return,          // завершает фрагмент со значением dst
+        PropagateReturn, // return вне тела метода: отмечает возврат в контексте и завершает фрагмент со значением dst
+        Execute,         // dst = результат выполнения инструкции дерева a
+    };
+
+    constexpr size_t OPCODE_COUNT = static_cast<size_t>(OpCode::Execute) + 1;
+
+    struct Instruction{
+        OpCode op;
+        uint32_t c = 0;
+        uint32_t dst = 0;
+        uint32_t a = 0;
+        uint32_t b = 0;
+    };
+
+    // Сравнение, выполняемое командой Compare
+    struct ComparisonSite{
+        const ast::Comparison::Comparator *comparator;
+        // Если не nullptr, сравнение выполняется этим методом caches, а не comparator
+        ast::Comparison::CachedComparator cached;
+        runtime::ComparisonCaches caches;
+    };
+
+    // Результат компиляции одной инструкции дерева: тело метода или программа целиком
+    struct Chunk{
+        std::vector<Instruction> code;
+        // Числа, строки, логические значения и объявленные классы, на которые ссылаются команды
+        std::vector<runtime::ObjectHolder> constants;
+        // Классы, экземпляры которых создаёт команда NewInstance
+        std::vector<const runtime::Class *> classes;
+        // Сравнения команд Compare вместе с кешами методов __eq__ и __lt__ каждого места сравнения
+        std::vector<ComparisonSite> comparisons;
+        // Инструкции, которые не компилируются и выполняются обходом дерева
+        std::vector<runtime::Executable *> statements;
+        // Кеши методов команд CallMethod, InitOrSkip, CallInit, PrintValue, Stringify и Add.
+        // Заполняются при выполнении
+        std::vector<runtime::MethodCache> method_caches;
+        // Кеши номеров полей команд LoadInnerField, LoadField и StoreField
+        std::vector<runtime::FieldCache> field_caches;
+        // Число регистров в кадре фрагмента
+        size_t register_count = 0;
+        // Фрагмент скомпилирован из ast::MethodBody и завершает возвраты,
+        // начатые return в инструкциях, выполняемых обходом дерева
+        bool is_method_body = false;
+    };
+
+    // Компилирует инструкцию в линейный байт-код. Если statement — ast::MethodBody,
+    // return внутри него завершает выполнение фрагмента; вне тела метода return
+    // ещё и отмечает возврат в контексте так же, как ast::Return.
+    // Инструкции вне ast компилируются в команду Execute
+    Chunk Compile(runtime::Executable &statement);
+
+    // Регистровая машина, исполняющая байт-код. Каждый выполняемый фрагмент получает кадр
+    // из register_count регистров в общем массиве машины. Тела методов, вызываемых из байт-кода,
+    // компилируются при первом вызове и кешируются. Методы, которые runtime вызывает
+    // самостоятельно (__str__, __eq__, __lt__), выполняются обходом дерева.
+    // Машина хранит указатели на инструкции программы, поэтому программу нельзя менять,
+    // пока машина используется
+    class VirtualMachine{
+    public:
+        explicit VirtualMachine(runtime::Context &context);
+
+        // Выполняет statement так же, как statement.Execute(closure, context)
+        runtime::ObjectHolder Execute(runtime::Executable &statement, runtime::Closure &closure);
+
+    private:
+        runtime::Context &context_;
+        std::unordered_map<const runtime::Executable *, Chunk> chunks_;
+        // Кадры всех выполняемых фрагментов, от внешнего к текущему
+        std::vector<runtime::ObjectHolder> registers_;
+
+        runtime::ObjectHolder Run(Chunk &chunk, runtime::Closure &closure, size_t frame);
+        // Вызывает найденный метод, забирая аргументы из регистров registers_[first_arg, first_arg + argument_count)
+        runtime::ObjectHolder CallMethod(runtime::ClassInstance &instance, const runtime::Method &method,
+                                         size_t first_arg, size_t argument_count);
+    };
+
+    // Способ выполнения программы
+    enum class Engine{
+        Tree,      // обход дерева методами Execute
+        Bytecode,  // компиляция в байт-код и выполнение VirtualMachine
+    };
+
+    // Возвращает способ выполнения, заданный переменной окружения MYTHON_ENGINE
+    // ("tree" или "bytecode"). По умолчанию программа выполняется обходом дерева
+    Engine GetEngineFromEnvironment();
+
+    // Выполняет программу выбранным способом. return вне метода завершает программу,
+    // и после неё контекст можно использовать для выполнения следующих программ
+    runtime::ObjectHolder ExecuteProgram(runtime::Executable &program, runtime::Closure &closure,
+                                         runtime::Context &context, Engine engine);
+
+} // namespace bytecode
@@ -0,0 +1,199 @@
+#include "incremental_parse.h"
+
+#include "parse.h"
+
+#include <stdexcept>
+#include <unordered_set>
+
+using namespace std;
+
+namespace parse {
+
+namespace {
+
+// Делит text на строки, каждая из которых заканчивается символом '\n'
+vector<string> SplitLines(string_view text) {
+    vector<string> lines;
+    while (!text.empty()) {
+        const size_t end = text.find('\n');
+        const size_t length = end == string_view::npos ? text.size() : end;
+        lines.emplace_back(text.substr(0, length));
+        lines.back().push_back('\n');
+        text.remove_prefix(min(length + 1, text.size()));
+    }
+    return lines;
+}
+
+// Имя класса, если лексемы tokens начинаются с его определения
+symbols::Symbol DeclaredClassName(const TokenBuffer& tokens) {
+    if (tokens.Size() > 1 && tokens.Kind(0) == TokenKindOf<token_type::Class>() &&
+        tokens.Kind(1) == TokenKindOf<token_type::Id>()) {
+        return symbols::Symbol::FromId(tokens.Payload(1));
+    }
+    return {};
+}
+
+bool UsesAnyOf(const TokenBuffer& tokens, const unordered_set<uint32_t>& names) {
+    for (size_t i = 0; i < tokens.Size(); ++i) {
+        if (tokens.Kind(i) == TokenKindOf<token_type::Id>() && names.count(tokens.Payload(i)) != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+}  // namespace
+
+IncrementalProgram::IncrementalProgram(string_view source)
+    : fragments_(Split(source)) {
+    runtime::Closure declared_classes;
+    for (auto& fragment : fragments_) {
+        program_.AddStatement(ParseFragment(fragment, declared_classes));
+        last_edit_.relexed_lines += fragment.line_count;
+        ++last_edit_.reparsed_statements;
+    }
+}
+
+vector<IncrementalProgram::Fragment> IncrementalProgram::Split(string_view source) {
+    vector<Fragment> fragments;
+    bool has_statement = false;
+    for (const string& line : SplitLines(source)) {
+        if (fragments.empty() || (has_statement && IsTopLevelLine(line))) {
+            fragments.emplace_back();
+            has_statement = false;
+        }
+        has_statement = has_statement || IsTopLevelLine(line);
+        fragments.back().text += line;
+        ++fragments.back().line_count;
+    }
+    for (auto& fragment : fragments) {
+        fragment.tokens = Lexer::Tokenize(fragment.text);
+    }
+    return fragments;
+}
+
+unique_ptr<ast::Statement> IncrementalProgram::ParseFragment(Fragment& fragment,
+                                                             runtime::Closure& declared_classes) {
+    Lexer lexer(fragment.tokens);
+    auto statement = ParseProgram(lexer, declared_classes);
+    fragment.class_name = DeclaredClassName(fragment.tokens);
+    fragment.cls = fragment.class_name.GetId() != 0 ? declared_classes.at(fragment.class_name)
+                                                    : runtime::ObjectHolder();
+    return statement;
+}
+
+void IncrementalProgram::Edit(size_t first_line, size_t line_count, string_view text) {
+    // Затронутые правкой фрагменты [first, last). Фрагмент перед правкой тоже разбирается заново,
+    // если правка начинается с его границы: первая строка могла получить отступ
+    size_t first = 0;
+    size_t first_start = 0;
+    while (first + 1 < fragments_.size() && first_start + fragments_[first].line_count <= first_line) {
+        first_start += fragments_[first].line_count;
+        ++first;
+    }
+    if (first > 0 && first_start == first_line) {
+        --first;
+        first_start -= fragments_[first].line_count;
+    }
+    size_t last = first;
+    size_t last_end = first_start;
+    while (last < fragments_.size() && (last_end < first_line + line_count || last == first)) {
+        last_end += fragments_[last].line_count;
+        ++last;
+    }
+    if (first_line + line_count > last_end) {
+        throw out_of_range("Edit range is out of the source"s);
+    }
+
+    // Текст затронутых фрагментов с применённой правкой
+    string region_source;
+    for (size_t i = first; i < last; ++i) {
+        region_source += fragments_[i].text;
+    }
+    vector<string> lines = SplitLines(region_source);
+    vector<string> inserted = SplitLines(text);
+    const auto edit_begin = lines.begin() + static_cast<ptrdiff_t>(first_line - first_start);
+    lines.insert(lines.erase(edit_begin, edit_begin + static_cast<ptrdiff_t>(line_count)),
+                 inserted.begin(), inserted.end());
+    region_source.clear();
+    for (const string& line : lines) {
+        region_source += line;
+    }
+
+    EditStats stats;
+    stats.relexed_lines = lines.size();
+
+    runtime::Closure declared_classes;
+    for (size_t i = 0; i < first; ++i) {
+        if (fragments_[i].cls) {
+            declared_classes.emplace(fragments_[i].class_name, fragments_[i].cls);
+        }
+    }
+
+    // Классы, объявления которых могли измениться: фрагменты, ссылающиеся на них, разбираются заново
+    unordered_set<uint32_t> changed_classes;
+    for (size_t i = first; i < last; ++i) {
+        if (fragments_[i].cls) {
+            changed_classes.insert(fragments_[i].class_name.GetId());
+        }
+    }
+
+    vector<Fragment> region = Split(region_source);
+    vector<unique_ptr<ast::Statement>> region_statements;
+    for (auto& fragment : region) {
+        region_statements.push_back(ParseFragment(fragment, declared_classes));
+        if (fragment.cls) {
+            changed_classes.insert(fragment.class_name.GetId());
+        }
+    }
+    stats.reparsed_statements = region.size();
+
+    struct Reparsed {
+        size_t index;
+        unique_ptr<ast::Statement> statement;
+        symbols::Symbol class_name;
+        runtime::ObjectHolder cls;
+    };
+    vector<Reparsed> dependents;
+    for (size_t i = last; i < fragments_.size(); ++i) {
+        const Fragment& fragment = fragments_[i];
+        if (!UsesAnyOf(fragment.tokens, changed_classes)) {
+            if (fragment.cls) {
+                declared_classes.emplace(fragment.class_name, fragment.cls);
+            }
+            continue;
+        }
+        Fragment reparsed{{}, 0, fragment.tokens, {}, {}};
+        auto statement = ParseFragment(reparsed, declared_classes);
+        if (reparsed.cls) {
+            changed_classes.insert(reparsed.class_name.GetId());
+        }
+        dependents.push_back({i, std::move(statement), reparsed.class_name, reparsed.cls});
+    }
+    stats.reparsed_statements += dependents.size();
+
+    // Разбор прошёл успешно, изменения можно применить
+    const size_t region_size = region.size();
+    fragments_.erase(fragments_.begin() + static_cast<ptrdiff_t>(first),
+                     fragments_.begin() + static_cast<ptrdiff_t>(last));
+    fragments_.insert(fragments_.begin() + static_cast<ptrdiff_t>(first),
+                      make_move_iterator(region.begin()), make_move_iterator(region.end()));
+    program_.Splice(first, last - first, std::move(region_statements));
+    for (auto& dependent : dependents) {
+        const size_t index = dependent.index - (last - first) + region_size;
+        fragments_[index].class_name = dependent.class_name;
+        fragments_[index].cls = std::move(dependent.cls);
+        program_.ReplaceStatement(index, std::move(dependent.statement));
+    }
+    last_edit_ = stats;
+}
+
+string IncrementalProgram::GetSource() const {
+    string source;
+    for (const auto& fragment : fragments_) {
+        source += fragment.text;
+    }
+    return source;
+}
+
+}  // namespace parse
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "lexer.h"
+#include "runtime.h"
+#include "statement.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace parse {
+
+// Программа, которая после правки исходника лексируется и разбирается заново лишь частично.
+// Исходник делится на фрагменты по строкам верхнего уровня (строкам без отступа, кроме
+// комментариев и else): каждый фрагмент содержит одну инструкцию верхнего уровня и
+// лексируется независимо, поэтому баланс Indent/Dedent внутри него всегда сохраняется.
+// После правки заново читаются только затронутые фрагменты, а также фрагменты,
+// ссылающиеся на классы, объявления которых изменились
+class IncrementalProgram {
+public:
+    // Сведения о последней правке
+    struct EditStats {
+        size_t relexed_lines = 0;        // строк лексировано заново
+        size_t reparsed_statements = 0;  // инструкций верхнего уровня разобрано заново
+    };
+
+    explicit IncrementalProgram(std::string_view source);
+
+    // Заменяет line_count строк исходника, начиная со строки first_line (нумерация с нуля),
+    // строками text. Если при разборе возникла ошибка, программа остаётся прежней
+    void Edit(size_t first_line, size_t line_count, std::string_view text);
+
+    // Дерево программы: по одной инструкции на каждый фрагмент исходника
+    [[nodiscard]] ast::Compound& GetProgram() {
+        return program_;
+    }
+
+    [[nodiscard]] std::string GetSource() const;
+
+    [[nodiscard]] const EditStats& GetLastEditStats() const {
+        return last_edit_;
+    }
+
+private:
+    struct Fragment {
+        std::string text;
+        size_t line_count = 0;
+        TokenBuffer tokens;
+        // Класс, объявленный фрагментом, если это определение класса
+        symbols::Symbol class_name;
+        runtime::ObjectHolder cls;
+    };
+
+    std::vector<Fragment> fragments_;
+    ast::Compound program_;
+    EditStats last_edit_;
+
+    static std::vector<Fragment> Split(std::string_view source);
+    static std::unique_ptr<ast::Statement> ParseFragment(Fragment& fragment,
+                                                         runtime::Closure& declared_classes);
+};
+
+}  // namespace parse
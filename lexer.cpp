@@ -1,9 +1,14 @@
 #include "lexer.h"
+#include "lexer_scan.h"
 
 #include <algorithm>
+#include <array>
+#include <cctype>
 #include <charconv>
-#include <unordered_map>
-#include <unordered_set>
+#include <cstring>
+#include <optional>
+#include <thread>
+#include <utility>
 
 using namespace std;
 
@@ -81,210 +86,532 @@ namespace parse
     }
 
     namespace {
-            const std::unordered_set<char> MARKS{'(', ')', ',', '.', ':', '+', '-', '*', '/', '=', '<', '>', '!', '?'};
-            const std::unordered_map<std::string, Token> KEY_WORDS{
-                {"class",token_type::Class{}},
-                {"return",token_type::Return{}},
-                {"if",token_type::If{}},
-                {"else",token_type::Else{}},
-                {"def",token_type::Def{}},
-                {"print",token_type::Print{}},
-                {"or",token_type::Or{}},
-                {"None",token_type::None{}},
-                {"and",token_type::And{}},
-                {"not",token_type::Not{}},
-                {"True",token_type::True{}},
-                {"False",token_type::False{}}
-            };
-}
+        struct Keyword{
+            std::string_view text;
+            size_t kind;
+        };
+
+        constexpr Keyword KEY_WORDS[] = {
+            {"class"sv, TokenKindOf<token_type::Class>()},
+            {"return"sv, TokenKindOf<token_type::Return>()},
+            {"if"sv, TokenKindOf<token_type::If>()},
+            {"else"sv, TokenKindOf<token_type::Else>()},
+            {"def"sv, TokenKindOf<token_type::Def>()},
+            {"print"sv, TokenKindOf<token_type::Print>()},
+            {"or"sv, TokenKindOf<token_type::Or>()},
+            {"None"sv, TokenKindOf<token_type::None>()},
+            {"and"sv, TokenKindOf<token_type::And>()},
+            {"not"sv, TokenKindOf<token_type::Not>()},
+            {"True"sv, TokenKindOf<token_type::True>()},
+            {"False"sv, TokenKindOf<token_type::False>()},
+        };
+
+        // Совершенная хеш-функция по первому и последнему символам и длине слова.
+        // Множители подбираются на этапе компиляции так, чтобы ключевые слова не давали коллизий
+        constexpr size_t KEYWORD_TABLE_SIZE = 32;
+
+        constexpr size_t KeywordHash(std::string_view word, size_t first_factor, size_t last_factor){
+            return (static_cast<unsigned char>(word.front()) * first_factor +
+                    static_cast<unsigned char>(word.back()) * last_factor + word.size()) %
+                   KEYWORD_TABLE_SIZE;
+        }
+
+        struct KeywordTable{
+            size_t first_factor = 0;
+            size_t last_factor = 0;
+            // Номер ключевого слова в KEY_WORDS, увеличенный на 1; 0 — пустая ячейка
+            std::array<uint8_t, KEYWORD_TABLE_SIZE> slots{};
+        };
+
+        constexpr KeywordTable BuildKeywordTable(){
+            for (size_t first_factor = 1; first_factor < 64; ++first_factor){
+                for (size_t last_factor = 1; last_factor < 64; ++last_factor){
+                    KeywordTable table{first_factor, last_factor, {}};
+                    bool collision = false;
+                    for (size_t i = 0; i < std::size(KEY_WORDS) && !collision; ++i){
+                        auto &slot = table.slots[KeywordHash(KEY_WORDS[i].text, first_factor, last_factor)];
+                        collision = slot != 0;
+                        slot = static_cast<uint8_t>(i + 1);
+                    }
+                    if (!collision){
+                        return table;
+                    }
+                }
+            }
+            return {};
+        }
+
+        constexpr KeywordTable KEYWORD_TABLE = BuildKeywordTable();
+        static_assert(KEYWORD_TABLE.first_factor != 0, "no perfect hash for the keyword list");
+
+        // Возвращает тег лексемы ключевого слова word либо nullopt, если word — не ключевое слово
+        constexpr std::optional<size_t> FindKeyword(std::string_view word){
+            const uint8_t slot = KEYWORD_TABLE.slots[KeywordHash(word, KEYWORD_TABLE.first_factor,
+                                                                 KEYWORD_TABLE.last_factor)];
+            if (slot != 0 && KEY_WORDS[slot - 1].text == word){
+                return KEY_WORDS[slot - 1].kind;
+            }
+            return std::nullopt;
+        }
 
+        static_assert(FindKeyword("def"sv) == TokenKindOf<token_type::Def>());
+        static_assert(!FindKeyword("Def"sv).has_value());
 
+        template <size_t... Kinds>
+        Token MakeTokenImpl(size_t kind, std::index_sequence<Kinds...>){
+            using Factory = Token (*)();
+            static constexpr Factory FACTORIES[] = {
+                []() -> Token { return Token(std::in_place_index<Kinds>); }...};
+            return FACTORIES[kind]();
+        }
+    } // namespace
 
-    Lexer::Lexer(std::istream &input){
-        ParseTokens(input);
+    Token MakeToken(size_t kind){
+        return MakeTokenImpl(kind, std::make_index_sequence<std::variant_size_v<TokenBase>>{});
     }
 
-    const Token &Lexer::CurrentToken() const{
+    void TokenBuffer::Push(const Token &token){
+        using namespace token_type;
 
+        if (const auto *number = token.TryAs<Number>()){
+            PushKind(token.index(), static_cast<uint32_t>(number->value));
+        }
+        else if (const auto *id = token.TryAs<Id>()){
+            PushKind(token.index(), id->value.GetId());
+        }
+        else if (const auto *ch = token.TryAs<Char>()){
+            PushKind(token.index(), static_cast<unsigned char>(ch->value));
+        }
+        else if (const auto *str = token.TryAs<String>()){
+            PushString(str->value);
+        }
+        else{
+            PushKind(token.index());
+        }
+    }
+
+    void TokenBuffer::PushKind(size_t kind, uint32_t payload){
+        kinds_.push_back(static_cast<uint8_t>(kind));
+        payloads_.push_back(payload);
+    }
+
+    void TokenBuffer::PushString(std::string_view value){
+        PushKind(TokenKindOf<token_type::String>(), static_cast<uint32_t>(string_offsets_.size() - 1));
+        strings_.append(value);
+        string_offsets_.push_back(static_cast<uint32_t>(strings_.size()));
+    }
 
-        if (current_pos_ >= tokens.size()){
-            return tokens.back();
+    void TokenBuffer::Append(const TokenBuffer &other){
+        const auto string_base = static_cast<uint32_t>(string_offsets_.size() - 1);
+        const auto char_base = static_cast<uint32_t>(strings_.size());
+        kinds_.insert(kinds_.end(), other.kinds_.begin(), other.kinds_.end());
+        payloads_.reserve(payloads_.size() + other.payloads_.size());
+        for (size_t i = 0; i < other.Size(); ++i){
+            const bool is_string = other.kinds_[i] == TokenKindOf<token_type::String>();
+            payloads_.push_back(other.payloads_[i] + (is_string ? string_base : 0));
         }
-        return tokens[current_pos_];
+        for (size_t i = 1; i < other.string_offsets_.size(); ++i){
+            string_offsets_.push_back(other.string_offsets_[i] + char_base);
+        }
+        strings_.append(other.strings_);
     }
 
-    Token Lexer::NextToken(){
-        if (tokens.empty()){
-            return token_type::Eof{};
+    void TokenBuffer::PopBack(){
+        if (kinds_.back() == TokenKindOf<token_type::String>()){
+            string_offsets_.pop_back();
+            strings_.resize(string_offsets_.back());
         }
-        ++current_pos_;
-        return CurrentToken();
+        kinds_.pop_back();
+        payloads_.pop_back();
     }
 
-    void Lexer::ParseTokens(std::istream &input)
-    {
-        std::string line;
-        while (getline(input, line)){
-            if(line.empty()){
-                continue;
-            }
-            std::istringstream in(line);
-            ParseIndent(in);
-            while (in){
-              const char c = in.peek();
-                if (isdigit(c)){
-                    ParseNumber(in);
-                }
-                else if (c == '\'' || c == '"'){
-                    ParseString(in);                   
-                }
-                else if (MARKS.count(c)){
-                    ParseOperation(in);
-                }
-                else if (c == '#'){
+    std::string_view TokenBuffer::StringAt(size_t index) const{
+        const uint32_t string_index = payloads_[index];
+        const uint32_t begin = string_offsets_[string_index];
+        return std::string_view(strings_).substr(begin, string_offsets_[string_index + 1] - begin);
+    }
+
+    Token TokenBuffer::Get(size_t index) const{
+        using namespace token_type;
+
+        const size_t kind = kinds_[index];
+        const uint32_t payload = payloads_[index];
+        if (kind == TokenKindOf<Number>()){
+            return Number{static_cast<int>(payload)};
+        }
+        if (kind == TokenKindOf<Id>()){
+            return Id{symbols::Symbol::FromId(payload)};
+        }
+        if (kind == TokenKindOf<Char>()){
+            return Char{static_cast<char>(payload)};
+        }
+        if (kind == TokenKindOf<String>()){
+            return String{std::string(StringAt(index))};
+        }
+        return MakeToken(kind);
+    }
+
+    void TokenBuffer::Clear(){
+        kinds_.clear();
+        payloads_.clear();
+        string_offsets_.resize(1);
+        strings_.clear();
+    }
+
+    void TokenBuffer::ShrinkToFit(){
+        kinds_.shrink_to_fit();
+        payloads_.shrink_to_fit();
+        string_offsets_.shrink_to_fit();
+        strings_.shrink_to_fit();
+    }
+
+    size_t TokenBuffer::MemoryUsage() const{
+        return kinds_.capacity() * sizeof(uint8_t) + payloads_.capacity() * sizeof(uint32_t) +
+               string_offsets_.capacity() * sizeof(uint32_t) + strings_.capacity();
+    }
+
+    Lexer::Lexer(std::istream &input)
+        : input_(&input){
+        NextToken();
+    }
+
+    Lexer::Lexer(std::string_view source)
+        : source_(source){
+        NextToken();
+    }
+
+    Lexer::Lexer(TokenBuffer tokens)
+        : pending_(std::move(tokens)), finished_(true){
+        NextToken();
+    }
+
+    TokenBuffer Lexer::Tokenize(std::string_view source){
+        Lexer lexer(TokenBuffer{});
+        lexer.source_ = source;
+        lexer.finished_ = false;
+        while (!lexer.finished_){
+            lexer.ReadNextLine();
+        }
+        lexer.pending_.ShrinkToFit();
+        return std::move(lexer.pending_);
+    }
+
+    TokenBuffer Lexer::TokenizeParallel(std::string_view source, size_t thread_count){
+        if (thread_count == 0){
+            thread_count = std::max(1U, std::thread::hardware_concurrency());
+        }
+
+        // Части начинаются со строк верхнего уровня, ближайших к равным долям source
+        std::vector<std::string_view> chunks;
+        const size_t chunk_size = source.size() / thread_count + 1;
+        size_t begin = 0;
+        while (begin < source.size()){
+            size_t end = std::min(begin + chunk_size, source.size());
+            while (end < source.size()){
+                end = source.find('\n', end - 1);
+                end = end == std::string_view::npos ? source.size() : end + 1;
+                if (end == source.size() || IsTopLevelLine(source.substr(end))){
                     break;
                 }
-                else{
-                    ParseWord(in);
+                ++end;
+            }
+            chunks.push_back(source.substr(begin, end - begin));
+            begin = end;
+        }
+        if (chunks.size() < 2){
+            return Tokenize(source);
+        }
 
+        std::vector<TokenBuffer> results(chunks.size());
+        std::vector<std::exception_ptr> errors(chunks.size());
+        std::vector<std::thread> threads;
+        threads.reserve(chunks.size());
+        for (size_t i = 0; i < chunks.size(); ++i){
+            threads.emplace_back([&, i](){
+                try{
+                    results[i] = Tokenize(chunks[i]);
                 }
+                catch (...){
+                    errors[i] = std::current_exception();
+                }
+            });
+        }
+        for (auto &thread : threads){
+            thread.join();
+        }
+
+        // Лексемы Dedent в конце части совпадают с теми, что последовательный лексер выдал бы
+        // перед первой строкой следующей части, поэтому достаточно убрать Eof каждой части
+        TokenBuffer tokens;
+        for (size_t i = 0; i < chunks.size(); ++i){
+            if (errors[i]){
+                std::rethrow_exception(errors[i]);
             }
-            if (!tokens.empty() && !tokens.back().Is<token_type::Newline>()){
-                tokens.push_back(token_type::Newline{});
+            if (i + 1 < chunks.size()){
+                results[i].PopBack();
             }
+            tokens.Append(results[i]);
+        }
+        tokens.ShrinkToFit();
+        return tokens;
+    }
 
+    bool IsTopLevelLine(std::string_view line){
+        if (line.empty() || (scan::ClassOf(line.front()) & (scan::SPACE | scan::COMMENT)) != 0 ||
+            line.front() == '\n'){
+            return false;
         }
-        if (indent_number_ > 0){
-            for (size_t i = 0; i < indent_number_; ++i){
-               tokens.push_back(token_type::Dedent{});
+        constexpr std::string_view ELSE = "else"sv;
+        return line.substr(0, ELSE.size()) != ELSE || scan::FindWordEnd(line) != ELSE.size();
+    }
+
+    const Token &Lexer::CurrentToken() const{
+        if (!current_token_valid_){
+            current_token_ = pending_position_ != 0 ? pending_.Get(pending_position_ - 1) : Token(token_type::Eof{});
+            current_token_valid_ = true;
+        }
+        return current_token_;
+    }
+
+    const Token &Lexer::NextToken(){
+        Advance();
+        return CurrentToken();
+    }
+
+    void Lexer::Advance(){
+        current_token_valid_ = false;
+        if (pending_position_ < pending_.Size()){
+            ++pending_position_;
+            return;
+        }
+        if (finished_){
+            // После конца файла лексер остаётся на последней лексеме
+            return;
+        }
+        // Текущая лексема — последняя прочитанная, буфер можно переиспользовать для следующей строки
+        pending_.Clear();
+        pending_position_ = 0;
+        while (pending_.Empty() && !finished_){
+            ReadNextLine();
+        }
+        pending_position_ = pending_.Empty() ? 0 : 1;
+    }
+
+    size_t Lexer::CurrentKind() const{
+        return pending_position_ != 0 ? pending_.Kind(pending_position_ - 1) : TokenKindOf<token_type::Eof>();
+    }
+
+    uint32_t Lexer::CurrentPayload() const{
+        return pending_position_ != 0 ? pending_.Payload(pending_position_ - 1) : 0;
+    }
+
+    std::string_view Lexer::CurrentString() const{
+        return pending_.StringAt(pending_position_ - 1);
+    }
+
+    bool Lexer::ReadLine(std::string_view &line){
+        if (input_ != nullptr){
+            if (!getline(*input_, line_buffer_)){
+                return false;
             }
+            line = line_buffer_;
+            return true;
         }
+        if (source_.empty()){
+            return false;
+        }
+        const auto *end = static_cast<const char *>(std::memchr(source_.data(), '\n', source_.size()));
+        const size_t length = end != nullptr ? static_cast<size_t>(end - source_.data()) : source_.size();
+        line = source_.substr(0, length);
+        source_.remove_prefix(std::min(length + 1, source_.size()));
+        return true;
+    }
 
-        tokens.push_back(token_type::Eof{});
+    void Lexer::ReadNextLine(){
+        std::string_view line;
+        if (ReadLine(line)){
+            ParseLine(line);
+            return;
+        }
+        for (size_t i = 0; i < indent_number_; ++i){
+            PushToken(TokenKindOf<token_type::Dedent>());
+        }
+        indent_number_ = 0;
+        PushToken(TokenKindOf<token_type::Eof>());
+        finished_ = true;
     }
 
-    void Lexer::ParseString(std::istream &input)
+    void Lexer::PushToken(size_t kind, uint32_t payload){
+        has_tokens_ = true;
+        last_is_newline_ = kind == TokenKindOf<token_type::Newline>();
+        pending_.PushKind(kind, payload);
+    }
+
+    void Lexer::ParseLine(std::string_view line)
     {
-        std::string s;
-        const char quote = input.get();
+        if(line.empty()){
+            return;
+        }
+        ParseIndent(line);
+        while (!line.empty()){
+            const uint8_t char_class = scan::ClassOf(line.front());
+            if (char_class & scan::DIGIT){
+                ParseNumber(line);
+            }
+            else if (char_class & scan::QUOTE){
+                ParseString(line);
+            }
+            else if (char_class & scan::MARK){
+                ParseOperation(line);
+            }
+            else if (char_class & scan::COMMENT){
+                break;
+            }
+            else{
+                ParseWord(line);
+            }
+        }
+        if (has_tokens_ && !last_is_newline_){
+            PushToken(TokenKindOf<token_type::Newline>());
+        }
+    }
+
+    void Lexer::ParseString(std::string_view &input)
+    {
+        const char quote = input.front();
+        input.remove_prefix(1);
+
+        // Участки строки между escape-последовательностями копируются целиком
+        std::string &s = string_buffer_;
+        s.clear();
         while (true){
-            const char ch = input.get();
+            const size_t special = scan::FindQuoteOrEscape(input, quote);
+            if (special == std::string_view::npos){
+                throw std::runtime_error("ERROR:incorrect string");
+            }
+            s.append(input.substr(0, special));
+            const char ch = input[special];
+            input.remove_prefix(special + 1);
             if (ch == quote){
                 break;
-            }else if (ch == '\\')
-            {
-                const char symbol = input.get();
-                if(input.peek() == -1)
-                    throw std::runtime_error("ERROR:incorrect string");
-                switch (symbol)
-                {
-                case 'n':
-                    s.push_back('\n');
-                    break;
-                case 't':
-                    s.push_back('\t');
-                    break;
-                case '"':
-                    s.push_back('"');
-                    break;
-                case '\'':
-                    s.push_back('\'');
-                    break;
-                default:
-                    throw std::runtime_error("ERROR:invalid escape symbol");
-                }
             }
-            else{
-                if(input.peek() == -1)
 
-                    throw std::runtime_error("ERROR:incorrect string");
-                s.push_back(ch);
+            if(input.size() < 2)
+                throw std::runtime_error("ERROR:incorrect string");
+            const char symbol = input.front();
+            input.remove_prefix(1);
+            switch (symbol)
+            {
+            case 'n':
+                s.push_back('\n');
+                break;
+            case 't':
+                s.push_back('\t');
+                break;
+            case '"':
+                s.push_back('"');
+                break;
+            case '\'':
+                s.push_back('\'');
+                break;
+            default:
+                throw std::runtime_error("ERROR:invalid escape symbol");
             }
         }
-        tokens.push_back(token_type::String{s});
+        has_tokens_ = true;
+        last_is_newline_ = false;
+        pending_.PushString(s);
     }
 
-    void Lexer::ParseNumber(std::istream &input)
+    void Lexer::ParseNumber(std::string_view &input)
     {
-        std::string parsed_num;
-        while (std::isdigit(input.peek()))
-        {
-            parsed_num += static_cast<char>(input.get());
+        int value = 0;
+        const auto [end, error] = std::from_chars(input.data(), input.data() + input.size(), value);
+        if (error == std::errc::result_out_of_range){
+            throw LexerError("ERROR:number is out of range"s);
         }
+        input.remove_prefix(static_cast<size_t>(end - input.data()));
 
-        tokens.push_back(token_type::Number{std::stoi(parsed_num)});
+        PushToken(TokenKindOf<token_type::Number>(), static_cast<uint32_t>(value));
     }
 
-    void Lexer::ParseWord(std::istream &input){
-        std::string s;
-        char c = input.get();
-        while (c != ' ' && c != EOF && c != '\n'){
-            if (c == '#' || MARKS.count(c)){
-                input.putback(c);
-                break;
-            }
-            s += c;
-            c = input.get();
+    void Lexer::ParseWord(std::string_view &input){
+        const size_t length = scan::FindWordEnd(input);
+        if (length == 0){
+            // Пробел между лексемами
+            input.remove_prefix(1);
+            return;
         }
-        if (!s.empty()){
 
-           const auto it = KEY_WORDS.find(s);
-            if(it != KEY_WORDS.end()){
-                tokens.push_back(it->second);
-            }
-            else{
-                tokens.push_back(token_type::Id{s});
-            }
+        const std::string_view word = input.substr(0, length);
+        input.remove_prefix(length);
+
+        if (const auto kind = FindKeyword(word)){
+            PushToken(*kind);
+        }
+        else{
+            PushToken(TokenKindOf<token_type::Id>(), InternWord(word));
         }
     }
 
-    void Lexer::ParseIndent(std::istream &input)
+    uint32_t Lexer::InternWord(std::string_view word){
+        if (input_ != nullptr){
+            // Строки потока не сохраняются, слово нельзя использовать как ключ
+            return symbols::Symbol(word).GetId();
+        }
+        auto [it, inserted] = word_ids_.try_emplace(word, 0);
+        if (inserted){
+            it->second = symbols::Symbol(word).GetId();
+        }
+        return it->second;
+    }
+
+    void Lexer::ParseIndent(std::string_view &input)
     {
-        size_t spaces_number = 0;
-        if (input.peek() == ' ')
-            while (input.peek() == ' ')
-            {
-                input.get();
-                ++spaces_number;
-            }
+        const size_t spaces_number = scan::SpacesPrefix(input);
+        input.remove_prefix(spaces_number);
+
         if (indent_number_ < spaces_number / 2){
             for (size_t i = 0; i < (spaces_number / 2) - indent_number_; ++i){
 
-                tokens.push_back(token_type::Indent{});
+                PushToken(TokenKindOf<token_type::Indent>());
             }
         }
         else if (indent_number_ > spaces_number / 2){
             for (size_t i = 0; i < indent_number_ - (spaces_number / 2); ++i){
 
-                tokens.push_back(token_type::Dedent{});
+                PushToken(TokenKindOf<token_type::Dedent>());
             }
         }
         indent_number_ = spaces_number / 2;
     }
 
-    void Lexer::ParseOperation(std::istream &input)
+    void Lexer::ParseOperation(std::string_view &input)
     {
-       const  char c = input.get();
-        if (c == '!' && input.peek() == '='){
-
-            tokens.push_back(token_type::NotEq{});
-            input.get();
+        const char c = input.front();
+        const char next = input.size() > 1 ? input[1] : '\0';
+        input.remove_prefix(1);
+        if (next != '='){
+            PushToken(TokenKindOf<token_type::Char>(), static_cast<unsigned char>(c));
+            return;
+        }
+        if (c == '!'){
+            PushToken(TokenKindOf<token_type::NotEq>());
         }
-        else if (c == '=' && input.peek() == '='){
-            tokens.push_back(token_type::Eq{});
-            input.get();
+        else if (c == '='){
+            PushToken(TokenKindOf<token_type::Eq>());
         }
-        else if (c == '<' && input.peek() == '='){
-            tokens.push_back(token_type::LessOrEq{});
-            input.get();
+        else if (c == '<'){
+            PushToken(TokenKindOf<token_type::LessOrEq>());
         }
-        else if (c == '>' && input.peek() == '='){
-                        tokens.push_back(token_type::GreaterOrEq{});
-            input.get();
+        else if (c == '>'){
+            PushToken(TokenKindOf<token_type::GreaterOrEq>());
         }
         else{
-            tokens.push_back(token_type::Char{c});
+            PushToken(TokenKindOf<token_type::Char>(), static_cast<unsigned char>(c));
+            return;
         }
+        input.remove_prefix(1);
     }
 
 } // namespace parse
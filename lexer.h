@@ -1,10 +1,15 @@
 #pragma once
 
+#include "symbol.h"
+
+#include <cstdint>
 #include <iosfwd>
 #include <optional>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <variant>
 #include <vector>
 
@@ -19,7 +24,7 @@ namespace parse
         };
 
         struct Id{                      // Лексема «идентификатор»
-            std::string value; // Имя идентификатора
+            symbols::Symbol value; // Интернированное имя идентификатора
         };
 
         struct Char{               // Лексема «символ»
@@ -140,6 +145,36 @@ namespace parse
         }
     };
 
+    namespace detail
+    {
+        template <typename T, typename Variant>
+        struct KindOf;
+
+        template <typename T, typename... Ts>
+        struct KindOf<T, std::variant<Ts...>>{
+            static constexpr size_t Find(){
+                constexpr bool matches[] = {std::is_same_v<T, Ts>...};
+                for (size_t i = 0; i < sizeof...(Ts); ++i){
+                    if (matches[i]){
+                        return i;
+                    }
+                }
+                return sizeof...(Ts);
+            }
+        };
+    } // namespace detail
+
+    // Порядковый номер (тег) типа лексемы T внутри Token
+    template <typename T>
+    constexpr size_t TokenKindOf(){
+        constexpr size_t kind = detail::KindOf<T, TokenBase>::Find();
+        static_assert(kind < std::variant_size_v<TokenBase>, "T is not a token type");
+        return kind;
+    }
+
+    // Создаёт лексему с тегом kind и значением по умолчанию
+    Token MakeToken(size_t kind);
+
     bool operator==(const Token &lhs, const Token &rhs);
     bool operator!=(const Token &lhs, const Token &rhs);
 
@@ -150,23 +185,145 @@ namespace parse
         using std::runtime_error::runtime_error;
     };
 
+    // Компактное хранилище лексем в виде структуры массивов.
+    // Для каждой лексемы хранится 1 байт тега (номер альтернативы Token)
+    // и 4 байта значения: номер имени для Id, число для Number, код символа для Char
+    // или номер строки в общей таблице строковых констант для String.
+    // Строковые константы лежат подряд в одном буфере символов
+    class TokenBuffer{
+    public:
+        void Push(const Token &token);
+        void PushKind(size_t kind, uint32_t payload = 0);
+        void PushString(std::string_view value);
+        // Дописывает в конец буфера все лексемы other
+        void Append(const TokenBuffer &other);
+        void PopBack();
+
+        [[nodiscard]] size_t Size() const{
+            return kinds_.size();
+        }
+
+        [[nodiscard]] bool Empty() const{
+            return kinds_.empty();
+        }
+
+        [[nodiscard]] size_t Kind(size_t index) const{
+            return kinds_[index];
+        }
+
+        [[nodiscard]] uint32_t Payload(size_t index) const{
+            return payloads_[index];
+        }
+
+        // Значение строковой константы, хранящейся в лексеме index
+        [[nodiscard]] std::string_view StringAt(size_t index) const;
+
+        // Восстанавливает лексему index в виде Token
+        [[nodiscard]] Token Get(size_t index) const;
+
+        void Clear();
+        void ShrinkToFit();
+
+        // Объём памяти, занимаемый лексемами, в байтах
+        [[nodiscard]] size_t MemoryUsage() const;
+
+    private:
+        std::vector<uint8_t> kinds_;
+        std::vector<uint32_t> payloads_;
+        // Строка номер i занимает символы [string_offsets_[i], string_offsets_[i + 1]) буфера strings_
+        std::vector<uint32_t> string_offsets_ = {0};
+        std::string strings_;
+    };
+
+    // Лексер работает в потоковом режиме: токены извлекаются из input по мере
+    // продвижения парсера, а не заранее для всего текста программы.
+    // В памяти одновременно хранятся лишь токены одной строки исходника.
     class Lexer
     {
     public:
         explicit Lexer(std::istream &input);
-
+        // Читает программу из непрерывного буфера (например, из MappedFile) без копирования строк.
+        // Буфер должен существовать, пока используется лексер
+        explicit Lexer(std::string_view source);
+        // Выдаёт лексемы, заранее прочитанные функцией Tokenize
+        explicit Lexer(TokenBuffer tokens);
+
+        // Читает всю программу из source в компактный буфер лексем
+        static TokenBuffer Tokenize(std::string_view source);
+        // То же, что Tokenize, но source делится на части по строкам верхнего уровня,
+        // и части лексируются параллельно в thread_count потоках.
+        // Результат совпадает с результатом Tokenize, включая выбрасываемые исключения
+        static TokenBuffer TokenizeParallel(std::string_view source, size_t thread_count = 0);
+
+        // Текущая лексема в виде Token. Token создаётся при первом обращении после перехода,
+        // поэтому парсер читает лексемы функциями CurrentKind, CurrentPayload и их обёртками
         [[nodiscard]] const Token &CurrentToken() const;
 
-        Token NextToken();
+        // Переходит к следующей лексеме и возвращает её в виде Token
+        const Token &NextToken();
 
-        // Если текущий токен имеет тип T, метод возвращает ссылку на него.
+        // Переходит к следующей лексеме, не создавая Token
+        void Advance();
+
+        // Тег и значение текущей лексемы в представлении TokenBuffer, прочитанные из буфера по номеру
+        [[nodiscard]] size_t CurrentKind() const;
+        [[nodiscard]] uint32_t CurrentPayload() const;
+
+        // Значение текущей строковой константы. Действительно до следующего перехода
+        [[nodiscard]] std::string_view CurrentString() const;
+
+        [[nodiscard]] symbols::Symbol CurrentId() const{
+            return symbols::Symbol::FromId(CurrentPayload());
+        }
+
+        [[nodiscard]] int CurrentNumber() const{
+            return static_cast<int>(CurrentPayload());
+        }
+
+        [[nodiscard]] char CurrentChar() const{
+            return static_cast<char>(CurrentPayload());
+        }
+
+        template <typename T>
+        [[nodiscard]] bool CurrentIs() const{
+            return CurrentKind() == TokenKindOf<T>();
+        }
+
+        // Проверяет, что текущая лексема — символ c
+        [[nodiscard]] bool CurrentIs(char c) const{
+            return CurrentIs<token_type::Char>() && CurrentPayload() == static_cast<unsigned char>(c);
+        }
+
+        // Если текущий токен имеет тип T, метод ничего не делает.
         // В противном случае метод выбрасывает исключение LexerError
         template <typename T>
-        const T &Expect() const{
+        void ExpectKind() const{
             using namespace std::literals;
-            if (!CurrentToken().Is<T>()){
+            if (!CurrentIs<T>()){
                 throw LexerError("ERROR:The token type does not match the declared one"s);
             }
+        }
+
+        // Проверяет, что текущий токен — символ c. В противном случае выбрасывает LexerError
+        void ExpectChar(char c) const{
+            using namespace std::literals;
+            ExpectKind<token_type::Char>();
+            if (!CurrentIs(c)){
+                throw LexerError("ERROR: The token type does not match the declared one or the values do not match"s);
+            }
+        }
+
+        // Возвращает имя текущего токена Id либо выбрасывает LexerError
+        symbols::Symbol ExpectId() const{
+            ExpectKind<token_type::Id>();
+            return CurrentId();
+        }
+
+        // Если текущий токен имеет тип T, метод возвращает ссылку на него.
+        // В противном случае метод выбрасывает исключение LexerError
+        template <typename T>
+        const T &Expect() const{
+            ExpectKind<T>();
             return CurrentToken().As<T>();
         }
 
@@ -180,14 +337,41 @@ namespace parse
             }
         }
 
-        // Если следующий токен имеет тип T, метод возвращает ссылку на него.
+        // Переходит к следующему токену и проверяет, что он имеет тип T.
         // В противном случае метод выбрасывает исключение LexerError
         template <typename T>
-        const T &ExpectNext(){
+        void ExpectNextKind(){
             using namespace std::literals;
-            if (!NextToken().Is<T>()){
+            Advance();
+            if (!CurrentIs<T>()){
                 throw LexerError("Not implemented"s);
             }
+        }
+
+        // Переходит к следующему токену и проверяет, что это символ c
+        void ExpectNextChar(char c){
+            Advance();
+            ExpectChar(c);
+        }
+
+        // Переходит к следующему токену и возвращает его имя, если это Id
+        symbols::Symbol ExpectNextId(){
+            ExpectNextKind<token_type::Id>();
+            return CurrentId();
+        }
+
+        // Переходит к следующему токену и возвращает значение строковой константы.
+        // Значение действительно до следующего перехода
+        std::string_view ExpectNextString(){
+            ExpectNextKind<token_type::String>();
+            return CurrentString();
+        }
+
+        // Если следующий токен имеет тип T, метод возвращает ссылку на него.
+        // В противном случае метод выбрасывает исключение LexerError
+        template <typename T>
+        const T &ExpectNext(){
+            ExpectNextKind<T>();
             return CurrentToken().As<T>();
         }
 
@@ -203,15 +387,38 @@ namespace parse
 
     private:
 
-        std::vector<Token> tokens;
-        size_t current_pos_ = 0;
+        std::istream *input_ = nullptr;
+        std::string line_buffer_;
+        std::string_view source_;
+        // Токены, уже прочитанные из input_; выданы парсеру первые pending_position_ из них,
+        // последний выданный — текущий
+        TokenBuffer pending_;
+        size_t pending_position_ = 0;
+        std::string string_buffer_;
+        // Номера имён для слов из source_; позволяют не обращаться к общей таблице имён
+        std::unordered_map<std::string_view, uint32_t> word_ids_;
+        // Текущая лексема, восстановленная CurrentToken
+        mutable Token current_token_ = token_type::Eof{};
+        mutable bool current_token_valid_ = false;
         size_t indent_number_ = 0;
-
-        void ParseTokens(std::istream &input);
-        void ParseString(std::istream &input);
-        void ParseNumber(std::istream &input);
-        void ParseWord(std::istream &input);
-        void ParseIndent(std::istream &input);
-        void ParseOperation(std::istream &input);
+        bool has_tokens_ = false;
+        bool last_is_newline_ = false;
+        bool finished_ = false;
+
+        bool ReadLine(std::string_view &line);
+        void ReadNextLine();
+        void ParseLine(std::string_view line);
+        void PushToken(size_t kind, uint32_t payload = 0);
+        void ParseString(std::string_view &input);
+        void ParseNumber(std::string_view &input);
+        void ParseWord(std::string_view &input);
+        void ParseIndent(std::string_view &input);
+        void ParseOperation(std::string_view &input);
+        uint32_t InternWord(std::string_view word);
     };
+
+    // Строка начинает инструкцию верхнего уровня: у неё нет отступа и она не является
+    // пустой строкой, комментарием или веткой else. Перед такой строкой лексер
+    // сбрасывает отступ в ноль, поэтому текст с неё можно лексировать независимо
+    bool IsTopLevelLine(std::string_view line);
 } // namespace parse
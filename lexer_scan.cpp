@@ -0,0 +1,205 @@
+#include "lexer_scan.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && defined(__SSE2__)
+#define MYTHON_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+namespace parse::scan
+{
+
+    namespace
+    {
+        using Kernel = size_t (*)(const char *data, size_t size, char quote);
+
+        // Скалярные реализации. Они же дорабатывают хвосты векторных версий
+
+        size_t SpacesPrefixScalar(const char *data, size_t size, char /*quote*/){
+            size_t i = 0;
+            while (i < size && data[i] == ' '){
+                ++i;
+            }
+            return i;
+        }
+
+        size_t WordEndScalar(const char *data, size_t size, char /*quote*/){
+            size_t i = 0;
+            while (i < size && (ClassOf(data[i]) & WORD_STOP) == 0){
+                ++i;
+            }
+            return i;
+        }
+
+        size_t QuoteOrEscapeScalar(const char *data, size_t size, char quote){
+            size_t i = 0;
+            while (i < size && data[i] != quote && data[i] != '\\'){
+                ++i;
+            }
+            return i;
+        }
+
+#ifdef MYTHON_SCAN_X86
+        // Векторные ядра проверяют WORD_STOP диапазонами байтов. Проверяем, что диапазоны
+        // совпадают с таблицей классов символов
+        constexpr bool WordStopMatchesRanges(){
+            for (int c = 0; c < 256; ++c){
+                const bool in_ranges = (c >= ' ' && c <= '!') || c == '#' || (c >= '(' && c <= '/') ||
+                                       c == ':' || (c >= '<' && c <= '?');
+                if (in_ranges != ((CHAR_CLASSES[static_cast<size_t>(c)] & WORD_STOP) != 0)){
+                    return false;
+                }
+            }
+            return true;
+        }
+        static_assert(WordStopMatchesRanges(), "vector word terminators are out of sync with CHAR_CLASSES");
+
+        // Байты, для которых (c - low) как беззнаковое число не превосходит high - low
+        inline __m128i InRange(__m128i v, char low, char high){
+            const __m128i shifted = _mm_sub_epi8(v, _mm_set1_epi8(low));
+            const __m128i limit = _mm_set1_epi8(static_cast<char>(high - low));
+            return _mm_cmpeq_epi8(_mm_min_epu8(shifted, limit), shifted);
+        }
+
+        // Пробел, '!', '#', "()*+,-./", ':', "<=>?" — всё, на чём заканчивается слово
+        inline __m128i WordTerminators(__m128i v){
+            __m128i result = InRange(v, ' ', '!');
+            result = _mm_or_si128(result, _mm_cmpeq_epi8(v, _mm_set1_epi8('#')));
+            result = _mm_or_si128(result, InRange(v, '(', '/'));
+            result = _mm_or_si128(result, _mm_cmpeq_epi8(v, _mm_set1_epi8(':')));
+            return _mm_or_si128(result, InRange(v, '<', '?'));
+        }
+
+        size_t SpacesPrefixSse2(const char *data, size_t size, char quote){
+            const __m128i space = _mm_set1_epi8(' ');
+            size_t i = 0;
+            for (; i + 16 <= size; i += 16){
+                const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+                const unsigned mask = ~static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, space))) & 0xFFFFu;
+                if (mask != 0){
+                    return i + static_cast<size_t>(__builtin_ctz(mask));
+                }
+            }
+            return i + SpacesPrefixScalar(data + i, size - i, quote);
+        }
+
+        size_t WordEndSse2(const char *data, size_t size, char quote){
+            size_t i = 0;
+            for (; i + 16 <= size; i += 16){
+                const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+                const auto mask = static_cast<unsigned>(_mm_movemask_epi8(WordTerminators(v)));
+                if (mask != 0){
+                    return i + static_cast<size_t>(__builtin_ctz(mask));
+                }
+            }
+            return i + WordEndScalar(data + i, size - i, quote);
+        }
+
+        size_t QuoteOrEscapeSse2(const char *data, size_t size, char quote){
+            const __m128i quotes = _mm_set1_epi8(quote);
+            const __m128i backslashes = _mm_set1_epi8('\\');
+            size_t i = 0;
+            for (; i + 16 <= size; i += 16){
+                const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+                const __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(v, quotes), _mm_cmpeq_epi8(v, backslashes));
+                const auto mask = static_cast<unsigned>(_mm_movemask_epi8(hits));
+                if (mask != 0){
+                    return i + static_cast<size_t>(__builtin_ctz(mask));
+                }
+            }
+            return i + QuoteOrEscapeScalar(data + i, size - i, quote);
+        }
+
+        __attribute__((target("avx2"))) inline __m256i InRange256(__m256i v, char low, char high){
+            const __m256i shifted = _mm256_sub_epi8(v, _mm256_set1_epi8(low));
+            const __m256i limit = _mm256_set1_epi8(static_cast<char>(high - low));
+            return _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, limit), shifted);
+        }
+
+        __attribute__((target("avx2"))) size_t SpacesPrefixAvx2(const char *data, size_t size, char quote){
+            const __m256i space = _mm256_set1_epi8(' ');
+            size_t i = 0;
+            for (; i + 32 <= size; i += 32){
+                const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+                const unsigned mask = ~static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, space)));
+                if (mask != 0){
+                    return i + static_cast<size_t>(__builtin_ctz(mask));
+                }
+            }
+            return i + SpacesPrefixSse2(data + i, size - i, quote);
+        }
+
+        __attribute__((target("avx2"))) size_t WordEndAvx2(const char *data, size_t size, char quote){
+            size_t i = 0;
+            for (; i + 32 <= size; i += 32){
+                const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+                __m256i hits = InRange256(v, ' ', '!');
+                hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('#')));
+                hits = _mm256_or_si256(hits, InRange256(v, '(', '/'));
+                hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(':')));
+                hits = _mm256_or_si256(hits, InRange256(v, '<', '?'));
+                const auto mask = static_cast<unsigned>(_mm256_movemask_epi8(hits));
+                if (mask != 0){
+                    return i + static_cast<size_t>(__builtin_ctz(mask));
+                }
+            }
+            return i + WordEndSse2(data + i, size - i, quote);
+        }
+
+        __attribute__((target("avx2"))) size_t QuoteOrEscapeAvx2(const char *data, size_t size, char quote){
+            const __m256i quotes = _mm256_set1_epi8(quote);
+            const __m256i backslashes = _mm256_set1_epi8('\\');
+            size_t i = 0;
+            for (; i + 32 <= size; i += 32){
+                const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+                const __m256i hits = _mm256_or_si256(_mm256_cmpeq_epi8(v, quotes), _mm256_cmpeq_epi8(v, backslashes));
+                const auto mask = static_cast<unsigned>(_mm256_movemask_epi8(hits));
+                if (mask != 0){
+                    return i + static_cast<size_t>(__builtin_ctz(mask));
+                }
+            }
+            return i + QuoteOrEscapeSse2(data + i, size - i, quote);
+        }
+#endif
+
+        struct Kernels{
+            const char *name;
+            Kernel spaces_prefix;
+            Kernel word_end;
+            Kernel quote_or_escape;
+        };
+
+        Kernels SelectKernels(){
+#ifdef MYTHON_SCAN_X86
+            if (__builtin_cpu_supports("avx2")){
+                return {"avx2", SpacesPrefixAvx2, WordEndAvx2, QuoteOrEscapeAvx2};
+            }
+            return {"sse2", SpacesPrefixSse2, WordEndSse2, QuoteOrEscapeSse2};
+#else
+            return {"scalar", SpacesPrefixScalar, WordEndScalar, QuoteOrEscapeScalar};
+#endif
+        }
+
+        const Kernels &GetKernels(){
+            static const Kernels kernels = SelectKernels();
+            return kernels;
+        }
+    } // namespace
+
+    size_t SpacesPrefix(std::string_view text){
+        return GetKernels().spaces_prefix(text.data(), text.size(), ' ');
+    }
+
+    size_t FindWordEnd(std::string_view text){
+        return GetKernels().word_end(text.data(), text.size(), ' ');
+    }
+
+    size_t FindQuoteOrEscape(std::string_view text, char quote){
+        const size_t pos = GetKernels().quote_or_escape(text.data(), text.size(), quote);
+        return pos < text.size() ? pos : std::string_view::npos;
+    }
+
+    const char *ActiveKernel(){
+        return GetKernels().name;
+    }
+
+} // namespace parse::scan
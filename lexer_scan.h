@@ -0,0 +1,67 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Ядра посимвольного сканирования для лексера.
+// На x86-64 используются векторные реализации (SSE2, а при поддержке процессором — AVX2),
+// выбираемые во время выполнения. На остальных платформах работает скалярная версия
+namespace parse::scan
+{
+
+    // Классы символов исходного текста (битовые флаги)
+    enum CharClass : uint8_t{
+        SPACE = 1 << 0,
+        DIGIT = 1 << 1,
+        MARK = 1 << 2,      // знак операции или пунктуации
+        QUOTE = 1 << 3,     // начало строковой константы
+        COMMENT = 1 << 4,   // начало комментария
+        WORD_STOP = 1 << 5, // символ, на котором заканчивается слово
+    };
+
+    // Знаки операций и пунктуации Mython
+    inline constexpr std::string_view MARKS = "(),.:+-*/=<>!?";
+
+    constexpr std::array<uint8_t, 256> BuildCharClasses(){
+        std::array<uint8_t, 256> classes{};
+        for (const char c : MARKS){
+            classes[static_cast<unsigned char>(c)] |= MARK | WORD_STOP;
+        }
+        for (char c = '0'; c <= '9'; ++c){
+            classes[static_cast<unsigned char>(c)] |= DIGIT;
+        }
+        classes[static_cast<unsigned char>(' ')] |= SPACE | WORD_STOP;
+        classes[static_cast<unsigned char>('#')] |= COMMENT | WORD_STOP;
+        classes[static_cast<unsigned char>('\'')] |= QUOTE;
+        classes[static_cast<unsigned char>('"')] |= QUOTE;
+        return classes;
+    }
+
+    inline constexpr std::array<uint8_t, 256> CHAR_CLASSES = BuildCharClasses();
+
+    constexpr uint8_t ClassOf(char c){
+        return CHAR_CLASSES[static_cast<unsigned char>(c)];
+    }
+
+    // Возвращает true, если c — знак операции или пунктуации Mython
+    constexpr bool IsMark(char c){
+        return (ClassOf(c) & MARK) != 0;
+    }
+
+    // Возвращает количество пробелов в начале text
+    size_t SpacesPrefix(std::string_view text);
+
+    // Возвращает позицию первого символа, завершающего слово: пробела, '#' или знака операции.
+    // Если такого символа нет, возвращает text.size()
+    size_t FindWordEnd(std::string_view text);
+
+    // Возвращает позицию первой кавычки quote либо обратной косой черты.
+    // Если таких символов нет, возвращает std::string_view::npos
+    size_t FindQuoteOrEscape(std::string_view text, char quote);
+
+    // Возвращает название используемой реализации: "avx2", "sse2" или "scalar"
+    const char *ActiveKernel();
+
+} // namespace parse::scan
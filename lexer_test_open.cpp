@@ -1,4 +1,5 @@
 #include "lexer.h"
+#include "lexer_scan.h"
 #include "test_runner_p.h"
 
 #include <sstream>
@@ -351,6 +352,164 @@ abc#
         ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
     }
 }
+
+void TestTokensAreReadOnDemand() {
+    istringstream input("x = 1\ny = 2\nz = 3\n"s);
+    Lexer lexer(input);
+
+    // Лексер прочитал только первую строку программы
+    ASSERT(!input.eof());
+    ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Id{"x"s}));
+
+    string rest;
+    getline(input, rest);
+    ASSERT_EQUAL(rest, "y = 2"s);
+}
+
+void TestBufferInputMatchesStream() {
+    const string program = R"(
+class Greeter:
+  def greet(name):
+    print 'Hello, ' + name, "\"quoted\"", 1024 # comment
+x = Greeter()
+if x != None and not False:
+  x.greet('world')
+)"s;
+
+    istringstream input(program);
+    Lexer stream_lexer(input);
+    Lexer buffer_lexer(string_view{program});
+
+    while (true) {
+        ASSERT_EQUAL(buffer_lexer.CurrentToken(), stream_lexer.CurrentToken());
+        if (stream_lexer.CurrentToken().Is<token_type::Eof>()) {
+            break;
+        }
+        stream_lexer.NextToken();
+        buffer_lexer.NextToken();
+    }
+}
+
+void TestIndexedAccessMatchesToken() {
+    istringstream input("x = 'str' + 42\nif x != None:\n  print x.y('z')\n"s);
+    Lexer lexer(input);
+
+    while (true) {
+        // Сначала читаем лексему по номеру, затем сравниваем с восстановленным Token
+        const size_t kind = lexer.CurrentKind();
+        if (lexer.CurrentIs<token_type::Number>()) {
+            ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Number{lexer.CurrentNumber()}));
+        } else if (lexer.CurrentIs<token_type::Id>()) {
+            ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Id{lexer.CurrentId()}));
+        } else if (lexer.CurrentIs<token_type::Char>()) {
+            ASSERT(lexer.CurrentIs(lexer.CurrentChar()));
+            ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Char{lexer.CurrentChar()}));
+        } else if (lexer.CurrentIs<token_type::String>()) {
+            ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::String{string(lexer.CurrentString())}));
+        }
+        ASSERT_EQUAL(kind, lexer.CurrentToken().index());
+        if (lexer.CurrentIs<token_type::Eof>()) {
+            break;
+        }
+        lexer.Advance();
+    }
+    lexer.Advance();
+    ASSERT(lexer.CurrentIs<token_type::Eof>());
+}
+
+void TestIdsAreInterned() {
+    istringstream input("value other value"s);
+    Lexer lexer(input);
+
+    const symbols::Symbol first = lexer.Expect<token_type::Id>().value;
+    const symbols::Symbol other = lexer.ExpectNext<token_type::Id>().value;
+    const symbols::Symbol second = lexer.ExpectNext<token_type::Id>().value;
+
+    ASSERT_EQUAL(first.GetId(), second.GetId());
+    ASSERT(first.GetId() != other.GetId());
+    ASSERT_EQUAL(first.GetName(), "value"s);
+    ASSERT_EQUAL(symbols::Symbol("value"sv).GetId(), first.GetId());
+}
+
+void TestTokenBufferIsCompact() {
+    string program;
+    for (int i = 0; i < 1000; ++i) {
+        program += "class Point"s + to_string(i) + ":\n  def __init__(x, y):\n    self.x = x + 1\n"s;
+        program += "    print 'point', self.x, \"\\tshift\", y != None\n"s;
+    }
+
+    const TokenBuffer tokens = Lexer::Tokenize(program);
+    ASSERT(tokens.MemoryUsage() * 5 <= tokens.Size() * sizeof(Token));
+
+    Lexer stream_lexer(string_view{program});
+    Lexer buffer_lexer(tokens);
+    size_t count = 0;
+    while (true) {
+        ASSERT_EQUAL(buffer_lexer.CurrentToken(), stream_lexer.CurrentToken());
+        ++count;
+        if (stream_lexer.CurrentToken().Is<token_type::Eof>()) {
+            break;
+        }
+        stream_lexer.NextToken();
+        buffer_lexer.NextToken();
+    }
+    ASSERT_EQUAL(count, tokens.Size());
+    ASSERT_EQUAL(buffer_lexer.NextToken(), Token(token_type::Eof{}));
+}
+
+void TestParallelTokenizeMatchesSequential() {
+    string program = "# generated\n\n"s;
+    for (int i = 0; i < 50; ++i) {
+        program += "class Shape"s + to_string(i) + ":\n  def area(w, h):\n"s;
+        program += "    if w > h:\n      return w * h\n    else:\n      return 'none'\n"s;
+        program += "# comment\n\nx"s + to_string(i) + " = \"line\\n\" + str(" + to_string(i) + ")\n"s;
+        program += "if x0 == None:\n  print 'nothing'\nelse:\n  print 'something'\n"s;
+    }
+
+    const TokenBuffer expected = Lexer::Tokenize(program);
+    for (size_t threads = 1; threads <= 16; ++threads) {
+        const TokenBuffer tokens = Lexer::TokenizeParallel(program, threads);
+        ASSERT_EQUAL(tokens.Size(), expected.Size());
+        for (size_t i = 0; i < tokens.Size(); ++i) {
+            ASSERT_EQUAL(tokens.Get(i), expected.Get(i));
+        }
+    }
+
+    // Ошибка в одной из частей передаётся вызывающему коду
+    program += "s = 'unterminated\n"s;
+    try {
+        Lexer::TokenizeParallel(program, 4);
+        ASSERT(false);
+    } catch (const runtime_error& error) {
+        ASSERT_EQUAL(string(error.what()), "ERROR:incorrect string"s);
+    }
+}
+
+void TestScanKernels() {
+    // Строки длиннее 32 символов проходят через векторные ветки, хвосты — через скалярные
+    const string spaces(70, ' ');
+    for (size_t n = 0; n < spaces.size(); ++n) {
+        const string text = spaces.substr(0, n) + "x  "s;
+        ASSERT_EQUAL(scan::SpacesPrefix(text), n);
+    }
+    ASSERT_EQUAL(scan::SpacesPrefix(spaces), spaces.size());
+
+    const string word(70, 'a');
+    for (const char stop : " #()*+,-./:<=>?!"s) {
+        for (size_t n = 0; n < word.size(); n += 7) {
+            const string text = word.substr(0, n) + stop + "bc"s;
+            ASSERT_EQUAL(scan::FindWordEnd(text), n);
+        }
+    }
+    ASSERT_EQUAL(scan::FindWordEnd(word + "_'\"\\\x80\t1;"s), word.size() + 8);
+
+    for (size_t n = 0; n < word.size(); n += 5) {
+        ASSERT_EQUAL(scan::FindQuoteOrEscape(word.substr(0, n) + "'\""s, '\''), n);
+        ASSERT_EQUAL(scan::FindQuoteOrEscape(word.substr(0, n) + "'\""s, '"'), n + 1);
+        ASSERT_EQUAL(scan::FindQuoteOrEscape(word.substr(0, n) + "\\'"s, '\''), n);
+    }
+    ASSERT_EQUAL(scan::FindQuoteOrEscape(word, '\''), string_view::npos);
+}
 }  // namespace
 
 void RunOpenLexerTests(TestRunner& tr) {
@@ -367,6 +526,13 @@ void RunOpenLexerTests(TestRunner& tr) {
     RUN_TEST(tr, parse::TestMythonProgram);
     RUN_TEST(tr, parse::TestAlwaysEmitsNewlineAtTheEndOfNonemptyLine);
     RUN_TEST(tr, parse::TestCommentsAreIgnored);
+    RUN_TEST(tr, parse::TestTokensAreReadOnDemand);
+    RUN_TEST(tr, parse::TestBufferInputMatchesStream);
+    RUN_TEST(tr, parse::TestIndexedAccessMatchesToken);
+    RUN_TEST(tr, parse::TestIdsAreInterned);
+    RUN_TEST(tr, parse::TestScanKernels);
+    RUN_TEST(tr, parse::TestTokenBufferIsCompact);
+    RUN_TEST(tr, parse::TestParallelTokenizeMatchesSequential);
 }
 
 }  // namespace parse
\ No newline at end of file
@@ -1,9 +1,13 @@
+#include "bytecode.h"
 #include "lexer.h"
+#include "mapped_file.h"
 #include "parse.h"
+#include "program_image.h"
 #include "runtime.h"
 #include "statement.h"
 #include "test_runner_p.h"
 
+#include <cstdlib>
 #include <iostream>
 
 using namespace std;
@@ -24,13 +28,52 @@ void TestParseProgram(TestRunner& tr);
 
 namespace {
 
+// Способ выполнения выбирается переменной окружения MYTHON_ENGINE, см. bytecode::GetEngineFromEnvironment
+void ExecuteMythonProgram(runtime::Executable& program, ostream& output) {
+    runtime::SimpleContext context{output};
+    runtime::Closure closure;
+    bytecode::ExecuteProgram(program, closure, context, bytecode::GetEngineFromEnvironment());
+}
+
+void RunMythonProgram(parse::Lexer& lexer, ostream& output) {
+    const ParsedProgram program = ParseProgramInArena(lexer);
+    ExecuteMythonProgram(*program.code, output);
+}
+
 void RunMythonProgram(istream& input, ostream& output) {
     parse::Lexer lexer(input);
-    auto program = ParseProgram(lexer);
+    RunMythonProgram(lexer, output);
+}
 
-    runtime::SimpleContext context{output};
-    runtime::Closure closure;
-    program->Execute(closure, context);
+ParsedProgram ParseMythonSource(string_view source) {
+    // Большие файлы выгоднее лексировать целиком и параллельно, небольшие — по мере разбора
+    constexpr size_t PARALLEL_LEXING_THRESHOLD = 1 << 20;
+
+    if (source.size() >= PARALLEL_LEXING_THRESHOLD) {
+        parse::Lexer lexer(parse::Lexer::TokenizeParallel(source));
+        return ParseProgramInArena(lexer);
+    }
+    parse::Lexer lexer(source);
+    return ParseProgramInArena(lexer);
+}
+
+// Если задана переменная окружения MYTHON_CACHE_DIR, разобранная программа сохраняется
+// в этом каталоге, и при следующих запусках с тем же исходником лексер и парсер не нужны
+void RunMythonFile(const string& path, ostream& output) {
+    parse::MappedFile file(path);
+    const char* cache_directory = getenv("MYTHON_CACHE_DIR");
+    if (cache_directory == nullptr || *cache_directory == '\0') {
+        ExecuteMythonProgram(*ParseMythonSource(file.GetData()).code, output);
+        return;
+    }
+
+    const image::ProgramCache cache(cache_directory);
+    auto program = cache.Load(file.GetData());
+    if (!program) {
+        program = ParseMythonSource(file.GetData());
+        cache.Store(file.GetData(), *program);
+    }
+    ExecuteMythonProgram(*program->code, output);
 }
 
 void TestSimplePrints() {
@@ -336,11 +379,15 @@ void TestAll() {
 
 }  // namespace
 
-int main() {
+int main(int argc, char* argv[]) {
     try {
         TestAll();
 
-        RunMythonProgram(cin, cout);
+        if (argc > 1) {
+            RunMythonFile(argv[1], cout);
+        } else {
+            RunMythonProgram(cin, cout);
+        }
     } catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
 		return 1;
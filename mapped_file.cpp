@@ -0,0 +1,49 @@
+#include "mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace parse
+{
+
+    MappedFile::MappedFile(const std::string &path){
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0){
+            throw MappedFileError("ERROR:cannot open file "s + path);
+        }
+
+        struct stat info{};
+        if (::fstat(fd, &info) != 0){
+            ::close(fd);
+            throw MappedFileError("ERROR:cannot stat file "s + path);
+        }
+        size_ = static_cast<size_t>(info.st_size);
+
+        // Пустой файл отобразить нельзя, для него остаётся пустой буфер
+        if (size_ > 0){
+            void *data = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED){
+                ::close(fd);
+                throw MappedFileError("ERROR:cannot map file "s + path);
+            }
+            ::madvise(data, size_, MADV_SEQUENTIAL);
+            data_ = static_cast<const char *>(data);
+        }
+        ::close(fd);
+    }
+
+    MappedFile::~MappedFile(){
+        if (data_ != nullptr){
+            ::munmap(const_cast<char *>(data_), size_);
+        }
+    }
+
+    std::string_view MappedFile::GetData() const{
+        return {data_, size_};
+    }
+
+} // namespace parse
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace parse
+{
+
+    class MappedFileError : public std::runtime_error{
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    // Файл, отображённый в память только для чтения.
+    // Содержимое доступно как непрерывный буфер, который можно передать в Lexer без копирования
+    class MappedFile{
+    public:
+        // Отображает файл path в память. При ошибке выбрасывает MappedFileError
+        explicit MappedFile(const std::string &path);
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        ~MappedFile();
+
+        [[nodiscard]] std::string_view GetData() const;
+
+    private:
+        const char *data_ = nullptr;
+        size_t size_ = 0;
+    };
+
+} // namespace parse
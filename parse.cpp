@@ -3,31 +3,30 @@
 #include "lexer.h"
 #include "statement.h"
 
+#include <optional>
+#include <utility>
+
 using namespace std;
 
 namespace TokenType = parse::token_type;
 
 namespace {
-bool operator==(const parse::Token& token, char c) {
-    const auto* p = token.TryAs<TokenType::Char>();
-    return p != nullptr && p->value == c;
-}
-
-bool operator!=(const parse::Token& token, char c) {
-    return !(token == c);
-}
+const symbols::Symbol STR_FUNCTION = "str"sv;
+const symbols::Symbol SELF = "self"sv;
+const symbols::Symbol SLOTS = "__slots__"sv;
 
 class Parser {
 public:
-    explicit Parser(parse::Lexer& lexer)
-        : lexer_(lexer) {
+    Parser(parse::Lexer& lexer, runtime::Closure& declared_classes)
+        : lexer_(lexer)
+        , declared_classes_(declared_classes) {
     }
 
     // Program -> eps
     //          | Statement \n Program
     unique_ptr<ast::Statement> ParseProgram() {
         auto result = make_unique<ast::Compound>();
-        while (!lexer_.CurrentToken().Is<TokenType::Eof>()) {
+        while (!lexer_.CurrentIs<TokenType::Eof>()) {
             result->AddStatement(ParseStatement());
         }
 
@@ -35,21 +34,59 @@ public:
     }
 
 private:
+    // Переменные и присваивания, встреченные в теле разбираемого метода
+    struct MethodScope {
+        vector<ast::VariableValue*> variables;
+        vector<ast::Assignment*> assignments;
+    };
+
+    // Связывает имена локальных переменных метода со слотами кадра и возвращает число слотов.
+    // Локальными считаются self, параметры и переменные, которым в теле присваивается значение;
+    // остальные имена по-прежнему ищутся в closure
+    static size_t BindLocals(const vector<symbols::Symbol>& formal_params, const MethodScope& scope) {
+        unordered_map<symbols::Symbol, uint32_t> slots;
+        slots[SELF] = 0;
+        // При совпадении имён параметров побеждает последний, как и при заполнении closure
+        for (size_t i = 0; i < formal_params.size(); ++i) {
+            slots[formal_params[i]] = static_cast<uint32_t>(i + 1);
+        }
+        auto slot_count = static_cast<uint32_t>(formal_params.size() + 1);
+        for (ast::Assignment* assignment : scope.assignments) {
+            const auto [it, inserted] = slots.emplace(assignment->GetName(), slot_count);
+            slot_count += inserted ? 1 : 0;
+            assignment->BindSlot(it->second);
+        }
+        for (ast::VariableValue* variable : scope.variables) {
+            if (const auto it = slots.find(variable->GetDottedIds().front()); it != slots.end()) {
+                variable->BindSlot(it->second);
+            }
+        }
+        return slot_count;
+    }
+
+    unique_ptr<ast::VariableValue> MakeVariable(vector<symbols::Symbol> dotted_ids) {
+        auto variable = make_unique<ast::VariableValue>(std::move(dotted_ids));
+        if (method_scope_ != nullptr) {
+            method_scope_->variables.push_back(variable.get());
+        }
+        return variable;
+    }
+
     // Suite -> NEWLINE INDENT (Statement)+ DEDENT
     unique_ptr<ast::Statement> ParseSuite()  // NOLINT
     {
-        lexer_.Expect<TokenType::Newline>();
-        lexer_.ExpectNext<TokenType::Indent>();
+        lexer_.ExpectKind<TokenType::Newline>();
+        lexer_.ExpectNextKind<TokenType::Indent>();
 
-        lexer_.NextToken();
+        lexer_.Advance();
 
         auto result = make_unique<ast::Compound>();
-        while (!lexer_.CurrentToken().Is<TokenType::Dedent>()) {
+        while (!lexer_.CurrentIs<TokenType::Dedent>()) {
             result->AddStatement(ParseStatement());  // NOLINT
         }
 
-        lexer_.Expect<TokenType::Dedent>();
-        lexer_.NextToken();
+        lexer_.ExpectKind<TokenType::Dedent>();
+        lexer_.Advance();
 
         return result;
     }
@@ -59,76 +96,112 @@ private:
     {
         vector<runtime::Method> result;
 
-        while (lexer_.CurrentToken().Is<TokenType::Def>()) {
+        while (lexer_.CurrentIs<TokenType::Def>()) {
             runtime::Method m;
 
-            m.name = lexer_.ExpectNext<TokenType::Id>().value;
-            lexer_.ExpectNext<TokenType::Char>('(');
+            m.name = lexer_.ExpectNextId();
+            lexer_.ExpectNextChar('(');
 
-            if (lexer_.NextToken().Is<TokenType::Id>()) {
-                m.formal_params.push_back(lexer_.Expect<TokenType::Id>().value);
-                while (lexer_.NextToken() == ',') {
-                    m.formal_params.push_back(lexer_.ExpectNext<TokenType::Id>().value);
+            lexer_.Advance();
+            if (lexer_.CurrentIs<TokenType::Id>()) {
+                m.formal_params.push_back(lexer_.CurrentId());
+                lexer_.Advance();
+                while (lexer_.CurrentIs(',')) {
+                    m.formal_params.push_back(lexer_.ExpectNextId());
+                    lexer_.Advance();
                 }
             }
 
-            lexer_.Expect<TokenType::Char>(')');
-            lexer_.ExpectNext<TokenType::Char>(':');
-            lexer_.NextToken();
+            lexer_.ExpectChar(')');
+            lexer_.ExpectNextChar(':');
+            lexer_.Advance();
 
+            MethodScope scope;
+            MethodScope* const outer_scope = std::exchange(method_scope_, &scope);
             m.body = std::make_unique<ast::MethodBody>(ParseSuite());  // NOLINT
+            method_scope_ = outer_scope;
+            m.local_count = BindLocals(m.formal_params, scope);
 
             result.push_back(std::move(m));
         }
         return result;
     }
 
-    // ClassDefinition -> Id ['(' Id ')'] : new_line indent MethodList dedent
+    // Slots -> __slots__ = String [, String]* new_line
+    optional<vector<symbols::Symbol>> ParseSlots() {
+        if (!lexer_.CurrentIs<TokenType::Id>() || lexer_.CurrentId() != SLOTS) {
+            return nullopt;
+        }
+        lexer_.ExpectNextChar('=');
+        vector<symbols::Symbol> result;
+        result.emplace_back(lexer_.ExpectNextString());
+        lexer_.Advance();
+        while (lexer_.CurrentIs(',')) {
+            result.emplace_back(lexer_.ExpectNextString());
+            lexer_.Advance();
+        }
+        lexer_.ExpectKind<TokenType::Newline>();
+        lexer_.Advance();
+        return result;
+    }
+
+    // ClassDefinition -> Id ['(' Id ')'] : new_line indent [Slots] MethodList dedent
+    // Класс без Slots должен содержать хотя бы один метод
     unique_ptr<ast::Statement> ParseClassDefinition()  // NOLINT
     {
-        string class_name = lexer_.Expect<TokenType::Id>().value;
+        const symbols::Symbol class_name = lexer_.ExpectId();
 
-        lexer_.NextToken();
+        lexer_.Advance();
 
         const runtime::Class* base_class = nullptr;
-        if (lexer_.CurrentToken() == '(') {
-            auto name = lexer_.ExpectNext<TokenType::Id>().value;
-            lexer_.ExpectNext<TokenType::Char>(')');
-            lexer_.NextToken();
+        if (lexer_.CurrentIs('(')) {
+            auto name = lexer_.ExpectNextId();
+            lexer_.ExpectNextChar(')');
+            lexer_.Advance();
 
             auto it = declared_classes_.find(name);
             if (it == declared_classes_.end()) {
-                throw ParseError("Base class "s + name + " not found for class "s + class_name);
+                throw ParseError("Base class "s + name.GetName() + " not found for class "s +
+                                 class_name.GetName());
             }
             base_class = static_cast<const runtime::Class*>(it->second.Get());  // NOLINT
         }
 
-        lexer_.Expect<TokenType::Char>(':');
-        lexer_.ExpectNext<TokenType::Newline>();
-        lexer_.ExpectNext<TokenType::Indent>();
-        lexer_.ExpectNext<TokenType::Def>();
+        lexer_.ExpectChar(':');
+        lexer_.ExpectNextKind<TokenType::Newline>();
+        lexer_.ExpectNextKind<TokenType::Indent>();
+        lexer_.Advance();
+        optional<vector<symbols::Symbol>> slots = ParseSlots();
+        if (!slots) {
+            lexer_.ExpectKind<TokenType::Def>();
+        }
         vector<runtime::Method> methods = ParseMethods();  // NOLINT
 
-        lexer_.Expect<TokenType::Dedent>();
-        lexer_.NextToken();
+        lexer_.ExpectKind<TokenType::Dedent>();
+        lexer_.Advance();
 
         auto [it, inserted] = declared_classes_.insert({
             class_name,
-            runtime::ObjectHolder::Own(runtime::Class(class_name, std::move(methods), base_class)),
+            slots ? runtime::ObjectHolder::Own(runtime::Class(class_name.GetName(), std::move(methods),
+                                                              base_class, std::move(*slots)))
+                  : runtime::ObjectHolder::Own(
+                        runtime::Class(class_name.GetName(), std::move(methods), base_class)),
         });
 
         if (!inserted) {
-            throw ParseError("Class "s + class_name + " already exists"s);
+            throw ParseError("Class "s + class_name.GetName() + " already exists"s);
         }
 
         return make_unique<ast::ClassDefinition>(it->second);
     }
 
-    vector<string> ParseDottedIds() {
-        vector<string> result(1, lexer_.Expect<TokenType::Id>().value);
+    vector<symbols::Symbol> ParseDottedIds() {
+        vector<symbols::Symbol> result(1, lexer_.ExpectId());
 
-        while (lexer_.NextToken() == '.') {
-            result.push_back(lexer_.ExpectNext<TokenType::Id>().value);
+        lexer_.Advance();
+        while (lexer_.CurrentIs('.')) {
+            result.push_back(lexer_.ExpectNextId());
+            lexer_.Advance();
         }
 
         return result;
@@ -137,46 +210,55 @@ private:
     //  AssgnOrCall -> DottedIds = Expr
     //               | DottedIds '(' ExprList ')'
     unique_ptr<ast::Statement> ParseAssignmentOrCall() {
-        lexer_.Expect<TokenType::Id>();
+        lexer_.ExpectKind<TokenType::Id>();
 
-        vector<string> id_list = ParseDottedIds();
-        string last_name = id_list.back();
+        vector<symbols::Symbol> id_list = ParseDottedIds();
+        symbols::Symbol last_name = id_list.back();
         id_list.pop_back();
 
-        if (lexer_.CurrentToken() == '=') {
-            lexer_.NextToken();
+        if (lexer_.CurrentIs('=')) {
+            lexer_.Advance();
 
             if (id_list.empty()) {
-                return make_unique<ast::Assignment>(std::move(last_name), ParseTest());
+                auto assignment = make_unique<ast::Assignment>(std::move(last_name), ParseTest());
+                if (method_scope_ != nullptr) {
+                    method_scope_->assignments.push_back(assignment.get());
+                }
+                return assignment;
+            }
+            auto assignment = make_unique<ast::FieldAssignment>(
+                ast::VariableValue{std::move(id_list)}, std::move(last_name), ParseTest());
+            if (method_scope_ != nullptr) {
+                method_scope_->variables.push_back(&assignment->GetObject());
             }
-            return make_unique<ast::FieldAssignment>(ast::VariableValue{std::move(id_list)},
-                                                     std::move(last_name), ParseTest());
+            return assignment;
         }
-        lexer_.Expect<TokenType::Char>('(');
-        lexer_.NextToken();
+        lexer_.ExpectChar('(');
+        lexer_.Advance();
 
         if (id_list.empty()) {
-            throw ParseError("Mython doesn't support functions, only methods: "s + last_name);
+            throw ParseError("Mython doesn't support functions, only methods: "s +
+                             last_name.GetName());
         }
 
         vector<unique_ptr<ast::Statement>> args;
-        if (lexer_.CurrentToken() != ')') {
+        if (!lexer_.CurrentIs(')')) {
             args = ParseTestList();
         }
-        lexer_.Expect<TokenType::Char>(')');
-        lexer_.NextToken();
+        lexer_.ExpectChar(')');
+        lexer_.Advance();
 
-        return make_unique<ast::MethodCall>(make_unique<ast::VariableValue>(std::move(id_list)),
-                                            std::move(last_name), std::move(args));
+        return make_unique<ast::MethodCall>(MakeVariable(std::move(id_list)), std::move(last_name),
+                                            std::move(args));
     }
 
     // Expr -> Adder ['+'/'-' Adder]*
     unique_ptr<ast::Statement> ParseExpression()  // NOLINT
     {
         unique_ptr<ast::Statement> result = ParseAdder();
-        while (lexer_.CurrentToken() == '+' || lexer_.CurrentToken() == '-') {
-            char op = lexer_.CurrentToken().As<TokenType::Char>().value;
-            lexer_.NextToken();
+        while (lexer_.CurrentIs('+') || lexer_.CurrentIs('-')) {
+            char op = lexer_.CurrentChar();
+            lexer_.Advance();
 
             if (op == '+') {
                 result = make_unique<ast::Add>(std::move(result), ParseAdder());
@@ -191,9 +273,9 @@ private:
     unique_ptr<ast::Statement> ParseAdder()  // NOLINT
     {
         unique_ptr<ast::Statement> result = ParseMult();
-        while (lexer_.CurrentToken() == '*' || lexer_.CurrentToken() == '/') {
-            char op = lexer_.CurrentToken().As<TokenType::Char>().value;
-            lexer_.NextToken();
+        while (lexer_.CurrentIs('*') || lexer_.CurrentIs('/')) {
+            char op = lexer_.CurrentChar();
+            lexer_.Advance();
 
             if (op == '*') {
                 result = make_unique<ast::Mult>(std::move(result), ParseMult());
@@ -215,37 +297,42 @@ private:
     //       | DottedIds
     unique_ptr<ast::Statement> ParseMult()  // NOLINT
     {
-        if (lexer_.CurrentToken() == '(') {
-            lexer_.NextToken();
+        if (lexer_.CurrentIs('(')) {
+            lexer_.Advance();
             auto result = ParseTest();
-            lexer_.Expect<TokenType::Char>(')');
-            lexer_.NextToken();
+            lexer_.ExpectChar(')');
+            lexer_.Advance();
             return result;
         }
-        if (lexer_.CurrentToken() == '-') {
-            lexer_.NextToken();
-            return make_unique<ast::Mult>(ParseMult(), make_unique<ast::NumericConst>(-1));
+        if (lexer_.CurrentIs('-')) {
+            lexer_.Advance();
+            auto operand = ParseMult();
+            // Отрицательное число вычисляется при разборе, а не умножением при каждом выполнении
+            if (const auto* number = dynamic_cast<const ast::NumericConst*>(operand.get())) {
+                return make_unique<ast::NumericConst>(-number->GetValue().GetValue());
+            }
+            return make_unique<ast::Mult>(std::move(operand), make_unique<ast::NumericConst>(-1));
         }
-        if (const auto* num = lexer_.CurrentToken().TryAs<TokenType::Number>()) {
-            int result = num->value;
-            lexer_.NextToken();
+        if (lexer_.CurrentIs<TokenType::Number>()) {
+            int result = lexer_.CurrentNumber();
+            lexer_.Advance();
             return make_unique<ast::NumericConst>(result);
         }
-        if (const auto* str = lexer_.CurrentToken().TryAs<TokenType::String>()) {
-            string result = str->value;
-            lexer_.NextToken();
+        if (lexer_.CurrentIs<TokenType::String>()) {
+            string result(lexer_.CurrentString());
+            lexer_.Advance();
             return make_unique<ast::StringConst>(std::move(result));
         }
-        if (lexer_.CurrentToken().Is<TokenType::True>()) {
-            lexer_.NextToken();
+        if (lexer_.CurrentIs<TokenType::True>()) {
+            lexer_.Advance();
             return make_unique<ast::BoolConst>(runtime::Bool(true));
         }
-        if (lexer_.CurrentToken().Is<TokenType::False>()) {
-            lexer_.NextToken();
+        if (lexer_.CurrentIs<TokenType::False>()) {
+            lexer_.Advance();
             return make_unique<ast::BoolConst>(runtime::Bool(false));
         }
-        if (lexer_.CurrentToken().Is<TokenType::None>()) {
-            lexer_.NextToken();
+        if (lexer_.CurrentIs<TokenType::None>()) {
+            lexer_.Advance();
             return make_unique<ast::None>();
         }
 
@@ -253,38 +340,38 @@ private:
     }
 
     std::unique_ptr<ast::Statement> ParseDottedIdsInMultExpr() {
-        vector<string> names = ParseDottedIds();
+        vector<symbols::Symbol> names = ParseDottedIds();
 
-        if (lexer_.CurrentToken() == '(') {
+        if (lexer_.CurrentIs('(')) {
             // various calls
             vector<unique_ptr<ast::Statement>> args;
-            if (lexer_.NextToken() != ')') {
+            lexer_.Advance();
+            if (!lexer_.CurrentIs(')')) {
                 args = ParseTestList();
             }
-            lexer_.Expect<TokenType::Char>(')');
-            lexer_.NextToken();
+            lexer_.ExpectChar(')');
+            lexer_.Advance();
 
             auto method_name = names.back();
             names.pop_back();
 
             if (!names.empty()) {
-                return make_unique<ast::MethodCall>(
-                    make_unique<ast::VariableValue>(std::move(names)), std::move(method_name),
-                    std::move(args));
+                return make_unique<ast::MethodCall>(MakeVariable(std::move(names)),
+                                                    std::move(method_name), std::move(args));
             }
             if (auto it = declared_classes_.find(method_name); it != declared_classes_.end()) {
                 return make_unique<ast::NewInstance>(
                     static_cast<const runtime::Class&>(*it->second), std::move(args));  // NOLINT
             }
-            if (method_name == "str"sv) {
+            if (method_name == STR_FUNCTION) {
                 if (args.size() != 1) {
                     throw ParseError("Function str takes exactly one argument"s);
                 }
                 return make_unique<ast::Stringify>(std::move(args.front()));
             }
-            throw ParseError("Unknown call to "s + method_name + "()"s);
+            throw ParseError("Unknown call to "s + method_name.GetName() + "()"s);
         }
-        return make_unique<ast::VariableValue>(std::move(names));
+        return MakeVariable(std::move(names));
     }
 
     vector<unique_ptr<ast::Statement>> ParseTestList()  // NOLINT
@@ -292,8 +379,8 @@ private:
         vector<unique_ptr<ast::Statement>> result;
         result.push_back(ParseTest());
 
-        while (lexer_.CurrentToken() == ',') {
-            lexer_.NextToken();
+        while (lexer_.CurrentIs(',')) {
+            lexer_.Advance();
             result.push_back(ParseTest());
         }
         return result;
@@ -302,20 +389,20 @@ private:
     // Condition -> if LogicalExpr: Suite [else: Suite]
     unique_ptr<ast::Statement> ParseCondition()  // NOLINT
     {
-        lexer_.Expect<TokenType::If>();
-        lexer_.NextToken();
+        lexer_.ExpectKind<TokenType::If>();
+        lexer_.Advance();
 
         auto condition = ParseTest();
 
-        lexer_.Expect<TokenType::Char>(':');
-        lexer_.NextToken();
+        lexer_.ExpectChar(':');
+        lexer_.Advance();
 
         auto if_body = ParseSuite();
 
         unique_ptr<ast::Statement> else_body;
-        if (lexer_.CurrentToken().Is<TokenType::Else>()) {
-            lexer_.ExpectNext<TokenType::Char>(':');
-            lexer_.NextToken();
+        if (lexer_.CurrentIs<TokenType::Else>()) {
+            lexer_.ExpectNextChar(':');
+            lexer_.Advance();
             else_body = ParseSuite();
         }
 
@@ -330,8 +417,8 @@ private:
     unique_ptr<ast::Statement> ParseTest()  // NOLINT
     {
         auto result = ParseAndTest();
-        while (lexer_.CurrentToken().Is<TokenType::Or>()) {
-            lexer_.NextToken();
+        while (lexer_.CurrentIs<TokenType::Or>()) {
+            lexer_.Advance();
             result = make_unique<ast::Or>(std::move(result), ParseAndTest());
         }
         return result;
@@ -340,8 +427,8 @@ private:
     unique_ptr<ast::Statement> ParseAndTest()  // NOLINT
     {
         auto result = ParseNotTest();
-        while (lexer_.CurrentToken().Is<TokenType::And>()) {
-            lexer_.NextToken();
+        while (lexer_.CurrentIs<TokenType::And>()) {
+            lexer_.Advance();
             result = make_unique<ast::And>(std::move(result), ParseNotTest());
         }
         return result;
@@ -349,8 +436,8 @@ private:
 
     unique_ptr<ast::Statement> ParseNotTest()  // NOLINT
     {
-        if (lexer_.CurrentToken().Is<TokenType::Not>()) {
-            lexer_.NextToken();
+        if (lexer_.CurrentIs<TokenType::Not>()) {
+            lexer_.Advance();
             return make_unique<ast::Not>(ParseNotTest());  // NOLINT
         }
         return ParseComparison();
@@ -361,35 +448,33 @@ private:
     {
         auto result = ParseExpression();
 
-        const auto tok = lexer_.CurrentToken();
-
-        if (tok == '<') {
-            lexer_.NextToken();
+        if (lexer_.CurrentIs('<')) {
+            lexer_.Advance();
             return make_unique<ast::Comparison>(runtime::Less, std::move(result),
                                                 ParseExpression());
         }
-        if (tok == '>') {
-            lexer_.NextToken();
+        if (lexer_.CurrentIs('>')) {
+            lexer_.Advance();
             return make_unique<ast::Comparison>(runtime::Greater, std::move(result),
                                                 ParseExpression());
         }
-        if (tok.Is<TokenType::Eq>()) {
-            lexer_.NextToken();
+        if (lexer_.CurrentIs<TokenType::Eq>()) {
+            lexer_.Advance();
             return make_unique<ast::Comparison>(runtime::Equal, std::move(result),
                                                 ParseExpression());
         }
-        if (tok.Is<TokenType::NotEq>()) {
-            lexer_.NextToken();
+        if (lexer_.CurrentIs<TokenType::NotEq>()) {
+            lexer_.Advance();
             return make_unique<ast::Comparison>(runtime::NotEqual, std::move(result),
                                                 ParseExpression());
         }
-        if (tok.Is<TokenType::LessOrEq>()) {
-            lexer_.NextToken();
+        if (lexer_.CurrentIs<TokenType::LessOrEq>()) {
+            lexer_.Advance();
             return make_unique<ast::Comparison>(runtime::LessOrEqual, std::move(result),
                                                 ParseExpression());
         }
-        if (tok.Is<TokenType::GreaterOrEq>()) {
-            lexer_.NextToken();
+        if (lexer_.CurrentIs<TokenType::GreaterOrEq>()) {
+            lexer_.Advance();
             return make_unique<ast::Comparison>(runtime::GreaterOrEqual, std::move(result),
                                                 ParseExpression());
         }
@@ -401,18 +486,16 @@ private:
     //           | if Condition
     unique_ptr<ast::Statement> ParseStatement()  // NOLINT
     {
-        const auto& tok = lexer_.CurrentToken();
-
-        if (tok.Is<TokenType::Class>()) {
-            lexer_.NextToken();
+        if (lexer_.CurrentIs<TokenType::Class>()) {
+            lexer_.Advance();
             return ParseClassDefinition();  // NOLINT
         }
-        if (tok.Is<TokenType::If>()) {
+        if (lexer_.CurrentIs<TokenType::If>()) {
             return ParseCondition();
         }
         auto result = ParseSimpleStatement();
-        lexer_.Expect<TokenType::Newline>();
-        lexer_.NextToken();
+        lexer_.ExpectKind<TokenType::Newline>();
+        lexer_.Advance();
         return result;
     }
 
@@ -420,16 +503,14 @@ private:
     //               | print ExpressionList
     //               | AssignmentOrCall
     unique_ptr<ast::Statement> ParseSimpleStatement() {
-        const auto& tok = lexer_.CurrentToken();
-
-        if (tok.Is<TokenType::Return>()) {
-            lexer_.NextToken();
+        if (lexer_.CurrentIs<TokenType::Return>()) {
+            lexer_.Advance();
             return make_unique<ast::Return>(ParseTest());
         }
-        if (tok.Is<TokenType::Print>()) {
-            lexer_.NextToken();
+        if (lexer_.CurrentIs<TokenType::Print>()) {
+            lexer_.Advance();
             vector<unique_ptr<ast::Statement>> args;
-            if (!lexer_.CurrentToken().Is<TokenType::Newline>()) {
+            if (!lexer_.CurrentIs<TokenType::Newline>()) {
                 args = ParseTestList();
             }
             return make_unique<ast::Print>(std::move(args));
@@ -438,11 +519,26 @@ private:
     }
 
     parse::Lexer& lexer_;
-    runtime::Closure declared_classes_;
+    runtime::Closure& declared_classes_;
+    // Тело метода, которое разбирается в данный момент, либо nullptr
+    MethodScope* method_scope_ = nullptr;
 };
 
 }  // namespace
 
 unique_ptr<runtime::Executable> ParseProgram(parse::Lexer& lexer) {
-    return Parser{lexer}.ParseProgram();
-}
\ No newline at end of file
+    runtime::Closure declared_classes;
+    return ParseProgram(lexer, declared_classes);
+}
+
+unique_ptr<runtime::Executable> ParseProgram(parse::Lexer& lexer,
+                                             runtime::Closure& declared_classes) {
+    return Parser{lexer, declared_classes}.ParseProgram();
+}
+
+ParsedProgram ParseProgramInArena(parse::Lexer& lexer) {
+    ParsedProgram program;
+    const runtime::ArenaScope scope(*program.arena);
+    program.code = ParseProgram(lexer, program.classes);
+    return program;
+}
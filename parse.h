@@ -1,5 +1,8 @@
 #pragma once
 
+#include "arena.h"
+#include "runtime.h"
+
 #include <memory>
 #include <stdexcept>
 
@@ -7,12 +10,25 @@ namespace parse {
 class Lexer;
 }
 
-namespace runtime {
-class Executable;
-}
-
 struct ParseError : std::runtime_error {
     using std::runtime_error::runtime_error;
 };
 
-std::unique_ptr<runtime::Executable> ParseProgram(parse::Lexer& lexer);
\ No newline at end of file
+std::unique_ptr<runtime::Executable> ParseProgram(parse::Lexer& lexer);
+
+// Разбирает программу, используя классы из declared_classes.
+// Объявленные в программе классы добавляются в declared_classes
+std::unique_ptr<runtime::Executable> ParseProgram(parse::Lexer& lexer,
+                                                  runtime::Closure& declared_classes);
+
+// Программа вместе с объявленными в ней классами. Узлы дерева программы и тела методов
+// её классов размещаются в арене программы и освобождаются вместе с ней
+struct ParsedProgram {
+    // Объявлена первой, чтобы разрушаться последней
+    std::unique_ptr<runtime::Arena> arena = std::make_unique<runtime::Arena>();
+    runtime::Closure classes;
+    std::unique_ptr<runtime::Executable> code;
+};
+
+// Разбирает программу, размещая её дерево в арене возвращаемого объекта
+ParsedProgram ParseProgramInArena(parse::Lexer& lexer);
@@ -1,8 +1,16 @@
+#include "bytecode.h"
+#include "incremental_parse.h"
 #include "lexer.h"
 #include "parse.h"
+#include "program_image.h"
 #include "statement.h"
 #include "test_runner_p.h"
 
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <optional>
+
 using namespace std;
 
 namespace parse {
@@ -244,6 +252,651 @@ print r, c, t1, t2
                  "Rect(10x20) Circle(52) Triangle(3, 4, 5) Wrong triangle\n"s);
 }
 
+string ExecuteProgram(runtime::Executable& program,
+                      bytecode::Engine engine = bytecode::Engine::Tree) {
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    bytecode::ExecuteProgram(program, closure, context, engine);
+    return context.output.str();
+}
+
+// Вывод программы и текст ошибки выполнения (пустой, если ошибки не было)
+struct ProgramResult {
+    string output;
+    string error;
+};
+
+// Выполняет программу обоими движками и проверяет, что результаты совпадают.
+// check вызывается после выполнения каждым движком с его контекстом и глобальными переменными
+ProgramResult ExecuteOnBothEngines(
+    runtime::Executable& program,
+    const function<void(runtime::DummyContext&, runtime::Closure&)>& check = {}) {
+    optional<ProgramResult> first;
+    for (const bytecode::Engine engine : {bytecode::Engine::Tree, bytecode::Engine::Bytecode}) {
+        runtime::DummyContext context;
+        runtime::Closure closure;
+        ProgramResult result;
+        try {
+            bytecode::ExecuteProgram(program, closure, context, engine);
+        } catch (const std::runtime_error& e) {
+            result.error = e.what();
+        }
+        result.output = context.output.str();
+        if (check) {
+            check(context, closure);
+        }
+        if (first) {
+            ASSERT_EQUAL(result.output, first->output);
+            ASSERT_EQUAL(result.error, first->error);
+        } else {
+            first = std::move(result);
+        }
+    }
+    return *first;
+}
+
+ProgramResult ExecuteOnBothEngines(
+    const string& program,
+    const function<void(runtime::DummyContext&, runtime::Closure&)>& check = {}) {
+    auto tree = ParseProgramFromString(program);
+    return ExecuteOnBothEngines(*tree, check);
+}
+
+void TestIncrementalEdits() {
+    const string program = R"(class Counter:
+  def __init__():
+    self.value = 0
+
+  def add(n):
+    self.value = self.value + n
+
+class Named(Counter):
+  def __str__():
+    return 'counter ' + str(self.value)
+
+x = 1
+if x > 0:
+  print 'positive'
+else:
+  print 'negative'
+c = Named()
+c.add(5)
+print c
+)"s;
+
+    IncrementalProgram incremental(program);
+    ASSERT_EQUAL(ExecuteProgram(incremental.GetProgram()), "positive\ncounter 5\n"s);
+
+    // Правка тела условия затрагивает только инструкцию if
+    incremental.Edit(13, 1, "  print 'x is', x\n"sv);
+    ASSERT_EQUAL(incremental.GetLastEditStats().reparsed_statements, 1U);
+    ASSERT_EQUAL(incremental.GetLastEditStats().relexed_lines, 4U);
+    ASSERT_EQUAL(ExecuteProgram(incremental.GetProgram()), "x is 1\ncounter 5\n"s);
+
+    // Изменение класса требует разобрать заново наследника и место создания объекта
+    incremental.Edit(5, 1, "    self.value = self.value + n * 10"sv);
+    ASSERT_EQUAL(incremental.GetLastEditStats().reparsed_statements, 3U);
+    ASSERT_EQUAL(ExecuteProgram(incremental.GetProgram()), "x is 1\ncounter 50\n"s);
+
+    // Вставка новых инструкций верхнего уровня
+    incremental.Edit(19, 0, "y = 2\nprint y\n"sv);
+    incremental.Edit(12, 0, "x = 0 - 1\n"sv);
+    ASSERT_EQUAL(ExecuteProgram(incremental.GetProgram()), "negative\ncounter 50\n2\n"s);
+
+    // Строка с отступом на границе фрагментов продолжает ветку else
+    incremental.Edit(17, 0, "  print 'still negative'\n"sv);
+    ASSERT_EQUAL(ExecuteProgram(incremental.GetProgram()),
+                 "negative\nstill negative\ncounter 50\n2\n"s);
+
+    {
+        istringstream source(incremental.GetSource());
+        parse::Lexer lexer(source);
+        ASSERT_EQUAL(ExecuteProgram(*ParseProgram(lexer)),
+                     "negative\nstill negative\ncounter 50\n2\n"s);
+    }
+
+    // Ошибочная правка не меняет программу
+    try {
+        incremental.Edit(0, 1, "class Other:"sv);
+        ASSERT(false);
+    } catch (const ParseError&) {
+    }
+    ASSERT_EQUAL(ExecuteProgram(incremental.GetProgram()),
+                 "negative\nstill negative\ncounter 50\n2\n"s);
+}
+
+void TestProgramImage() {
+    const string program = R"(
+class Shape:
+  def __str__():
+    return "Shape"
+
+  def area():
+    return None
+
+class Rect(Shape):
+  def __init__(w, h):
+    self.w = w
+    self.h = h
+
+  def area():
+    return self.w * self.h
+
+  def __lt__(other):
+    return self.area() < other.area()
+
+r = Rect(3, 4)
+s = Rect(10 / 2, 1 - -1)
+print r, s.area(), r < s, not r < s or False, str(s.w) + 'x' + str(s.h)
+if r.area() >= 12 and s.area() != 0:
+  print 'big', True
+else:
+  print 'small'
+x = Shape()
+print x.area() == None, x
+)"s;
+    const string expected = "Shape 10 False True 5x2\nbig True\nTrue Shape\n"s;
+
+    ParsedProgram parsed;
+    {
+        istringstream input(program);
+        parse::Lexer lexer(input);
+        parsed = ParseProgramInArena(lexer);
+    }
+    ASSERT_EQUAL(ExecuteProgram(*parsed.code), expected);
+
+    const string image_data = image::WriteImage(parsed, program);
+    ParsedProgram loaded = image::ReadImage(image_data, program);
+    ASSERT_EQUAL(ExecuteProgram(*loaded.code), expected);
+    ASSERT_EQUAL(loaded.classes.size(), 2U);
+    ASSERT_EQUAL(image::WriteImage(loaded, program), image_data);
+
+    // Образ другого исходника, повреждённый и усечённый образы отвергаются
+    for (const string& broken : {image_data, image_data.substr(0, image_data.size() / 2),
+                                 "X"s + image_data.substr(1)}) {
+        try {
+            image::ReadImage(broken, broken == image_data ? program + " "s : program);
+            ASSERT(false);
+        } catch (const image::ImageError&) {
+        }
+    }
+
+    const uint64_t hash = image::HashSource(program);
+    const auto directory = filesystem::temp_directory_path() / ("mython_image_test_"s + to_string(hash));
+    const image::ProgramCache cache(directory.string());
+    ASSERT(!cache.Load(program));
+    ASSERT(cache.Store(program, parsed));
+    auto cached = cache.Load(program);
+    ASSERT(cached.has_value());
+    ASSERT_EQUAL(ExecuteProgram(*cached->code), expected);
+    ASSERT(!cache.Load(program + "\n"s));
+
+    // Совпадение хешей: образ другого исходника той же длины лежит в файле для program
+    // и записан с хешем program
+    string colliding_source = program;
+    colliding_source.back() = ' ';
+    string colliding = image::WriteImage(parsed, colliding_source);
+    const size_t hash_offset = 16;
+    colliding.replace(hash_offset, sizeof(hash), reinterpret_cast<const char*>(&hash), sizeof(hash));
+    for (const auto& entry : filesystem::directory_iterator(directory)) {
+        ofstream(entry.path(), ios::binary | ios::trunc) << colliding;
+    }
+    ASSERT(!cache.Load(program));
+    filesystem::remove_all(directory);
+}
+
+void TestBytecodeEngine() {
+    const string program = R"(
+class Counter:
+  def __init__(start):
+    self.value = start
+
+  def next():
+    self.value = self.value + 1
+    return self.value
+
+  def __str__():
+    return "Counter:" + str(self.value)
+
+class Node:
+  def __init__(value, next):
+    self.value = value
+    self.next = next
+
+class Math:
+  def fib(n):
+    if n < 2:
+      return n
+    return self.fib(n - 1) + self.fib(n - 2)
+
+  def sign(x):
+    if x > 0:
+      if x > 100:
+        return "huge"
+      return "positive"
+    if x == 0:
+      return "zero"
+    return "negative"
+
+class Lazy:
+  def touch():
+    print "not evaluated"
+
+c = Counter(10)
+print c.next(), c, c.next()
+m = Math()
+print m.fib(15), m.sign(1000), m.sign(5), m.sign(0), m.sign(-3)
+list = Node(1, Node(2, Node(3, None)))
+print list.next.next.value, list.next.value * 10 / 4 - 1
+list.next.next.value = "three"
+print list.next.next.value
+print 0 or c.next(), "" and c.next(), c.next() and None, not 0
+if c.next():
+  print c
+l = Lazy(c.touch())
+print str(None), str(True), str(Lazy) + "!", 1 <= 2, "b" > "a", None == None
+)"s;
+    const string expected =
+        "11 Counter:11 12\n610 huge positive zero negative\n3 4\nthree\n13  None True\nCounter:15\n"
+        "None True None! True True True\n"s;
+
+    const ProgramResult result = ExecuteOnBothEngines(program);
+    ASSERT_EQUAL(result.output, expected);
+    ASSERT(result.error.empty());
+
+    // Ошибки выполнения возникают в той же точке программы и с тем же сообщением
+    for (const string& failing : {"x = 1\nprint x\nprint y\n"s, "print 1 / 0\n"s, "print 'a' - 1\n"s,
+                                  "class A:\n  def f():\n    return 1\na = A()\nprint a.f(1)\n"s,
+                                  "class A:\n  def f():\n    return 1\nprint 1\na = A()\nprint a.b.c\n"s}) {
+        ASSERT(!ExecuteOnBothEngines(failing).error.empty());
+    }
+}
+
+void TestManyComparisonsInChunk() {
+    // Номера компараторов не переполняются, даже если во фрагменте больше 65535 сравнений
+    string program;
+    for (size_t i = 0; i < 65536; ++i) {
+        program += "x = 1 < 2\n"s;
+    }
+    program += "print 1 == 1, 2 == 3, x\n"s;
+
+    const ProgramResult result = ExecuteOnBothEngines(program);
+    ASSERT_EQUAL(result.output, "True False True\n"s);
+    ASSERT(result.error.empty());
+}
+
+void TestBytecodeRegisters() {
+    istringstream input("x = 1 + 2 * 3\nprint x, not x\n");
+    parse::Lexer lexer(input);
+    auto tree = ParseProgram(lexer);
+
+    // Операнды команд — регистры кадра, поэтому промежуточные значения не перекладываются
+    const bytecode::Chunk chunk = bytecode::Compile(*tree);
+    ASSERT_EQUAL(chunk.register_count, 3U);
+    const vector<bytecode::OpCode> expected = {
+        bytecode::OpCode::LoadConst, bytecode::OpCode::LoadConst,  bytecode::OpCode::LoadConst,
+        bytecode::OpCode::Mult,      bytecode::OpCode::Add,        bytecode::OpCode::StoreName,
+        bytecode::OpCode::LoadName,  bytecode::OpCode::PrintValue, bytecode::OpCode::LoadName,
+        bytecode::OpCode::Not,       bytecode::OpCode::PrintValue, bytecode::OpCode::PrintEnd,
+        bytecode::OpCode::LoadNone,  bytecode::OpCode::Return,
+    };
+    ASSERT_EQUAL(chunk.code.size(), expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        ASSERT(chunk.code[i].op == expected[i]);
+    }
+    ASSERT_EQUAL(ExecuteProgram(*tree, bytecode::Engine::Bytecode), "7 False\n"s);
+}
+
+void TestMethodLocalSlots() {
+    const string program = R"(
+class C:
+  def f(a, b):
+    if a:
+      x = b
+    return x
+
+  def g(self):
+    return self
+
+c = C()
+print c.f(True, 5), c.g(7)
+print c.f(False, 1)
+)"s;
+    istringstream input(program);
+    parse::Lexer lexer(input);
+    runtime::Closure classes;
+    auto tree = ParseProgram(lexer, classes);
+
+    // self, a, b и x получают слоты кадра, имена ищутся в closure только на верхнем уровне
+    const auto& cls = *classes.at("C"s).TryAs<runtime::Class>();
+    ASSERT_EQUAL(cls.GetMethod("f"s)->local_count, 4U);
+    ASSERT_EQUAL(cls.GetMethod("g"s)->local_count, 2U);
+
+    const ProgramResult result = ExecuteOnBothEngines(*tree, [](runtime::DummyContext& context, runtime::Closure&) {
+        ASSERT(context.GetLocals() == nullptr);
+    });
+    // Переменной x значение не присвоено: как и раньше, это ошибка обращения к имени
+    ASSERT(!result.error.empty());
+    ASSERT_EQUAL(result.output, "5 7\n"s);
+}
+
+void TestFrameStack() {
+    // Глубокая рекурсия растит стек кадров, пока вызывающие методы держат на нём свои
+    // слоты и ещё не вычисленные аргументы; после роста слоты должны читаться по-прежнему
+    const string program = R"(
+class Summator:
+  def dec(n):
+    return n - 1
+
+  def sum(n):
+    if n < 1:
+      return 0
+    r = self.sum(self.dec(n))
+    return n + r
+
+  def fail(n):
+    if n < 1:
+      return self.missing()
+    return self.fail(n - 1)
+
+s = Summator()
+print s.sum(500)
+s.fail(100)
+)"s;
+    const ProgramResult result = ExecuteOnBothEngines(program, [](runtime::DummyContext& context, runtime::Closure&) {
+        // Кадры снимаются со стека и при выходе из метода по исключению
+        ASSERT_EQUAL(context.GetFrames().GetTop(), 0U);
+        ASSERT(context.GetLocals() == nullptr);
+    });
+    ASSERT(!result.error.empty());
+    ASSERT_EQUAL(result.output, "125250\n"s);
+}
+
+void TestReturnFromNestedIf() {
+    // return из вложенного if прекращает выполнение всех объемлющих инструкций тела метода,
+    // но не вызывающего метода
+    const string program = R"(
+class Classifier:
+  def classify(n):
+    if n > 0:
+      if n > 10:
+        print "big"
+        return "big"
+        print "unreachable"
+      print "small"
+      return "small"
+    print "negative"
+
+  def describe(n):
+    kind = self.classify(n)
+    print "kind", kind
+    return kind
+
+c = Classifier()
+big = c.describe(20)
+small = c.describe(5)
+negative = c.describe(-1)
+print big, small, negative
+)"s;
+    const ProgramResult result = ExecuteOnBothEngines(program, [](runtime::DummyContext& context, runtime::Closure&) {
+        ASSERT(!context.IsReturning());
+    });
+    ASSERT_EQUAL(result.output, "big\nkind big\nsmall\nkind small\nnegative\nkind None\nbig small None\n"s);
+    ASSERT(result.error.empty());
+}
+
+void TestTopLevelReturn() {
+    // return вне метода завершает программу, но не следующую программу в том же контексте
+    for (const bytecode::Engine engine : {bytecode::Engine::Tree, bytecode::Engine::Bytecode}) {
+        runtime::DummyContext context;
+        runtime::Closure closure;
+        auto returning = ParseProgramFromString("print 1\nreturn 2\nprint 3\n"s);
+        auto next = ParseProgramFromString("print 4\nif 1:\n  print 5\nprint 6\n"s);
+        bytecode::ExecuteProgram(*returning, closure, context, engine);
+        ASSERT(!context.IsReturning());
+        bytecode::ExecuteProgram(*next, closure, context, engine);
+        ASSERT_EQUAL(context.output.str(), "1\n4\n5\n6\n"s);
+    }
+}
+
+void TestPolymorphicCallSites() {
+    // Одни и те же места вызова получают объекты шести классов: больше, чем помещается в кеш методов
+    const string program = R"(
+class Shape:
+  def __init__(side):
+    self.side = side
+
+  def area():
+    return self.side * self.side
+
+  def __str__():
+    return "Shape"
+
+  def __eq__(other):
+    return self.area() == other.area()
+
+  def __lt__(other):
+    return self.area() < other.area()
+
+  def __add__(other):
+    return self.area() + other.area()
+
+class Rect(Shape):
+  def area():
+    return self.side * 2
+
+  def __str__():
+    return "Rect"
+
+class Line(Shape):
+  def area():
+    return 0
+
+class Dot(Line):
+  def __str__():
+    return "Dot"
+
+class Cube(Shape):
+  def area():
+    return self.side * self.side * 6
+
+class Tri(Rect):
+  def area():
+    return self.side * 3 / 2
+
+class Report:
+  def describe(shape, other):
+    return str(shape) + ":" + str(shape.area()) + ":" + str(shape + other) + ":" + str(shape < other) + ":" + str(shape == other)
+
+  def twice(shape, other):
+    first = self.describe(shape, other)
+    return first + " " + self.describe(shape, other)
+
+r = Report()
+base = Shape(2)
+print r.twice(Shape(2), base), r.twice(Rect(3), base), r.twice(Line(4), base)
+print r.twice(Dot(5), base), r.twice(Cube(1), base), r.twice(Tri(4), base)
+print r.twice(Shape(1), base), r.twice(Tri(2), base)
+print r.describe(base)
+)"s;
+    const string expected =
+        "Shape:4:8:False:True Shape:4:8:False:True Rect:6:10:False:False Rect:6:10:False:False "
+        "Shape:0:4:True:False Shape:0:4:True:False\n"
+        "Dot:0:4:True:False Dot:0:4:True:False Shape:6:10:False:False Shape:6:10:False:False "
+        "Rect:6:10:False:False Rect:6:10:False:False\n"
+        "Shape:1:5:True:False Shape:1:5:True:False Rect:3:7:True:False Rect:3:7:True:False\n"s;
+
+    const ProgramResult result = ExecuteOnBothEngines(program);
+    ASSERT_EQUAL(result.output, expected);
+    // Закешированный метод с другим числом аргументов не вызывается
+    ASSERT(!result.error.empty());
+}
+
+void TestOperatorCallSites() {
+    // Операции над объектами пяти классов, у каждого свои __str__, __eq__, __lt__ и __add__:
+    // больше, чем помещается в кеш одного места вызова
+    string program;
+    for (const char* name : {"A", "B", "C", "D", "E"}) {
+        program += "class "s + name + ":\n"
+            "  def __init__(v):\n"
+            "    self.v = v\n"
+            "  def __str__():\n"
+            "    return \""s + name + "\" + str(self.v)\n"
+            "  def __eq__(other):\n"
+            "    return self.v == other.v\n"
+            "  def __lt__(other):\n"
+            "    return self.v < other.v\n"
+            "  def __add__(other):\n"
+            "    return self.v + other.v\n";
+    }
+    program += R"(
+class Ops:
+  def show(x, y):
+    print x, str(x), x + y, x == y, x < y, x >= y
+
+  def other(x, y):
+    print y, str(y), y + x, y != x, y > x, y <= x
+
+o = Ops()
+o.show(A(1), A(2))
+o.show(B(2), B(2))
+o.show(C(3), C(1))
+o.show(D(4), D(4))
+o.show(E(5), E(6))
+o.other(E(1), E(2))
+o.other(A(3), A(3))
+)"s;
+    const string expected =
+        "A1 A1 3 False True False\n"
+        "B2 B2 4 True False True\n"
+        "C3 C3 4 False False True\n"
+        "D4 D4 8 True False True\n"
+        "E5 E5 11 False True False\n"
+        "E2 E2 3 True True False\n"
+        "A3 A3 6 False False True\n"s;
+
+    const ProgramResult result = ExecuteOnBothEngines(program);
+    ASSERT_EQUAL(result.output, expected);
+    ASSERT(result.error.empty());
+}
+
+void TestSlots() {
+    const string program = R"(
+class Point:
+  __slots__ = "x", "y"
+
+  def __init__(x, y):
+    self.x = x
+    self.y = y
+
+  def __str__():
+    return str(self.x) + "," + str(self.y)
+
+class Point3(Point):
+  __slots__ = "z"
+
+  def __init__(x, y, z):
+    self.x = x
+    self.y = y
+    self.z = z
+
+class Tagged(Point):
+  def tag(t):
+    self.t = t
+    return self
+
+class Record:
+  __slots__ = "a", "b"
+
+p = Point(1, 2)
+q = Point3(3, 4, 5)
+r = Record()
+r.a = p
+print p, q, q.z, r.a.x
+t = Tagged(7, 8)
+u = t.tag("dyn")
+print u.t, t
+p.z = 1
+print "unreachable"
+)"s;
+    const string expected = "1,2 3,4 5 1\ndyn 7,8\n"s;
+
+    ParsedProgram parsed;
+    {
+        istringstream input(program);
+        parse::Lexer lexer(input);
+        parsed = ParseProgramInArena(lexer);
+    }
+    ParsedProgram loaded = image::ReadImage(image::WriteImage(parsed, program), program);
+    for (const ParsedProgram* version : {&parsed, &loaded}) {
+        const auto& point = *version->classes.at("Point"s).TryAs<runtime::Class>();
+        ASSERT(point.IsLayoutFixed());
+        ASSERT_EQUAL(point.GetLayout().GetFieldCount(), 2U);
+        ASSERT_EQUAL(version->classes.at("Point3"s).TryAs<runtime::Class>()->GetLayout().Find("z"s), 2U);
+        ASSERT(!version->classes.at("Tagged"s).TryAs<runtime::Class>()->IsLayoutFixed());
+
+        const ProgramResult result = ExecuteOnBothEngines(*version->code);
+        ASSERT_EQUAL(result.output, expected);
+        // Присваивание полю, которого нет в __slots__, — ошибка
+        ASSERT(!result.error.empty());
+    }
+
+    ASSERT_THROWS(ParseProgramFromString("class A:\n  __slots__ = \"x\", \"x\"\n"s), std::runtime_error);
+}
+
+void TestUnassignedSlots() {
+    const string declarations = R"(
+class Record:
+  __slots__ = "a", "b"
+
+class Holder:
+  __slots__ = "record"
+
+h = Holder()
+h.record = Record()
+h.record.a = None
+print h.record.a
+)"s;
+    // Поле из __slots__, которому не присвоено значение, читается как отсутствующее поле
+    const pair<string, string> cases[] = {
+        {"print h.record.b\n"s, "ERROR: Unknown name"s},
+        {"print h.record.b.a\n"s, "ERROR:Accessing a non-existent field"s},
+        {"x = Holder()\nprint x.record\n"s, "ERROR: Unknown name"s},
+        {"x = Holder()\nprint x.record.a\n"s, "ERROR:Accessing a non-existent field"s},
+    };
+    for (const auto& [statement, message] : cases) {
+        const ProgramResult result =
+            ExecuteOnBothEngines(declarations + statement, [](runtime::DummyContext&, runtime::Closure& closure) {
+                const auto& record = *closure.at("h"s).TryAs<runtime::ClassInstance>()->Fields().at("record"s)
+                                          .TryAs<runtime::ClassInstance>();
+                ASSERT_EQUAL(record.Fields().size(), 1U);
+                ASSERT_EQUAL(record.Fields().count("b"s), 0U);
+                ASSERT(record.Fields().find("b"s) == record.Fields().end());
+                ASSERT(record.Fields().begin()->first == "a"s);
+            });
+        ASSERT_EQUAL(result.error, message);
+        ASSERT_EQUAL(result.output, "None\n"s);
+    }
+}
+
+void TestNegativeLiterals() {
+    auto tree = ParseProgramFromString("x = -5\ny = - -7\nz = -x\nprint x, y, z, 1 - -1\n"s);
+    const auto& statements = static_cast<const ast::Compound&>(*tree).GetStatements();
+
+    // Отрицательные числа становятся константами при разборе
+    const auto& x = static_cast<const ast::Assignment&>(*statements[0]).GetExpression();
+    const auto* x_value = dynamic_cast<const ast::NumericConst*>(&x);
+    ASSERT(x_value != nullptr && x_value->GetValue().GetValue() == -5);
+    const auto& y = static_cast<const ast::Assignment&>(*statements[1]).GetExpression();
+    ASSERT(dynamic_cast<const ast::NumericConst*>(&y) != nullptr);
+    const auto& z = static_cast<const ast::Assignment&>(*statements[2]).GetExpression();
+    ASSERT(dynamic_cast<const ast::Mult*>(&z) != nullptr);
+
+    const ProgramResult result = ExecuteOnBothEngines(*tree);
+    ASSERT_EQUAL(result.output, "-5 7 5 2\n"s);
+    ASSERT(result.error.empty());
+}
+
 }  // namespace parse
 
 void TestParseProgram(TestRunner& tr) {
@@ -255,4 +908,18 @@ void TestParseProgram(TestRunner& tr) {
     RUN_TEST(tr, parse::TestRecursion2);
     RUN_TEST(tr, parse::TestComplexLogicalExpression);
     RUN_TEST(tr, parse::TestClassicalPolymorphism);
+    RUN_TEST(tr, parse::TestIncrementalEdits);
+    RUN_TEST(tr, parse::TestProgramImage);
+    RUN_TEST(tr, parse::TestBytecodeEngine);
+    RUN_TEST(tr, parse::TestBytecodeRegisters);
+    RUN_TEST(tr, parse::TestManyComparisonsInChunk);
+    RUN_TEST(tr, parse::TestMethodLocalSlots);
+    RUN_TEST(tr, parse::TestFrameStack);
+    RUN_TEST(tr, parse::TestReturnFromNestedIf);
+    RUN_TEST(tr, parse::TestTopLevelReturn);
+    RUN_TEST(tr, parse::TestPolymorphicCallSites);
+    RUN_TEST(tr, parse::TestOperatorCallSites);
+    RUN_TEST(tr, parse::TestSlots);
+    RUN_TEST(tr, parse::TestUnassignedSlots);
+    RUN_TEST(tr, parse::TestNegativeLiterals);
 }
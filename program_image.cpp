@@ -0,0 +1,659 @@
+#include "program_image.h"
+
+#include "mapped_file.h"
+#include "statement.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+namespace image
+{
+
+    namespace
+    {
+        constexpr char MAGIC[8] = {'M', 'Y', 'T', 'H', 'I', 'M', 'G', '\0'};
+        // Увеличивается при любом изменении формата образа
+        constexpr uint32_t FORMAT_VERSION = 4;
+        // Образ читается без перестановки байтов, поэтому образ с другим порядком байтов отвергается
+        constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+        enum class NodeTag : uint8_t{
+            Null,
+            NumericConst,
+            StringConst,
+            BoolConst,
+            VariableValue,
+            Assignment,
+            FieldAssignment,
+            None,
+            Print,
+            MethodCall,
+            NewInstance,
+            Stringify,
+            Add,
+            Sub,
+            Mult,
+            Div,
+            Or,
+            And,
+            Not,
+            Compound,
+            MethodBody,
+            Return,
+            ClassDefinition,
+            IfElse,
+            Comparison,
+        };
+
+        using ComparatorFunction = bool (*)(const runtime::ObjectHolder &, const runtime::ObjectHolder &,
+                                            runtime::Context &);
+
+        // Сравнения записываются в образ номером функции в этом списке
+        constexpr ComparatorFunction COMPARATORS[] = {
+            runtime::Equal, runtime::NotEqual, runtime::Less,
+            runtime::Greater, runtime::LessOrEqual, runtime::GreaterOrEqual,
+        };
+
+        class ImageWriter final : public ast::StatementVisitor{
+        public:
+            explicit ImageWriter(const runtime::Closure &classes){
+                for (const auto &[name, holder] : classes){
+                    if (const auto *cls = holder.TryAs<runtime::Class>()){
+                        AddClass(*cls);
+                    }
+                }
+            }
+
+            std::string Write(const runtime::Executable &code, std::string_view source){
+                WriteValue(static_cast<uint32_t>(classes_.size()));
+                for (const runtime::Class *cls : classes_){
+                    WriteName(cls->GetName());
+                    const runtime::Class *parent = cls->GetParent();
+                    WriteValue(parent != nullptr ? class_indexes_.at(parent) + 1 : uint32_t{0});
+                    WriteValue(static_cast<uint8_t>(cls->DeclaresSlots()));
+                    if (cls->DeclaresSlots()){
+                        WriteNames(cls->GetSlots());
+                    }
+                    WriteValue(static_cast<uint32_t>(cls->GetMethods().size()));
+                    for (const runtime::Method &method : cls->GetMethods()){
+                        WriteName(method.name);
+                        WriteNames(method.formal_params);
+                        WriteValue(static_cast<uint32_t>(method.local_count));
+                        WriteNode(method.body.get());
+                    }
+                }
+                WriteNode(&code);
+
+                std::string image(MAGIC, sizeof(MAGIC));
+                AppendValue(image, FORMAT_VERSION);
+                AppendValue(image, BYTE_ORDER_MARK);
+                // Образ хранит сам исходник: совпадение хеша не доказывает, что исходник тот же
+                AppendValue(image, HashSource(source));
+                AppendValue(image, static_cast<uint64_t>(source.size()));
+                image += source;
+                AppendValue(image, static_cast<uint32_t>(names_.size()));
+                for (const uint32_t id : names_){
+                    const std::string &name = symbols::Symbol::FromId(id).GetName();
+                    AppendValue(image, static_cast<uint32_t>(name.size()));
+                    image += name;
+                }
+                image += body_;
+                return image;
+            }
+
+            void Visit(const ast::NumericConst &node) override{
+                WriteTag(NodeTag::NumericConst);
+                WriteValue(static_cast<int32_t>(node.GetValue().GetValue()));
+            }
+
+            void Visit(const ast::StringConst &node) override{
+                WriteTag(NodeTag::StringConst);
+                WriteString(node.GetValue().GetValue());
+            }
+
+            void Visit(const ast::BoolConst &node) override{
+                WriteTag(NodeTag::BoolConst);
+                WriteValue(static_cast<uint8_t>(node.GetValue().GetValue()));
+            }
+
+            void Visit(const ast::VariableValue &node) override{
+                WriteTag(NodeTag::VariableValue);
+                WriteNames(node.GetDottedIds());
+                WriteValue(node.GetSlot());
+            }
+
+            void Visit(const ast::Assignment &node) override{
+                WriteTag(NodeTag::Assignment);
+                WriteName(node.GetName());
+                WriteValue(node.GetSlot());
+                WriteNode(&node.GetExpression());
+            }
+
+            void Visit(const ast::FieldAssignment &node) override{
+                WriteTag(NodeTag::FieldAssignment);
+                WriteNames(node.GetObject().GetDottedIds());
+                WriteValue(node.GetObject().GetSlot());
+                WriteName(node.GetFieldName());
+                WriteNode(&node.GetExpression());
+            }
+
+            void Visit(const ast::None & /*node*/) override{
+                WriteTag(NodeTag::None);
+            }
+
+            void Visit(const ast::Print &node) override{
+                WriteTag(NodeTag::Print);
+                WriteNodes(node.GetArgs());
+            }
+
+            void Visit(const ast::MethodCall &node) override{
+                WriteTag(NodeTag::MethodCall);
+                WriteNode(&node.GetObject());
+                WriteName(node.GetMethod());
+                WriteNodes(node.GetArgs());
+            }
+
+            void Visit(const ast::NewInstance &node) override{
+                WriteTag(NodeTag::NewInstance);
+                WriteClass(node.GetClass());
+                WriteNodes(node.GetArgs());
+            }
+
+            void Visit(const ast::Stringify &node) override{
+                WriteTag(NodeTag::Stringify);
+                WriteNode(node.GetArg().get());
+            }
+
+            void Visit(const ast::Add &node) override{
+                WriteBinary(NodeTag::Add, node);
+            }
+
+            void Visit(const ast::Sub &node) override{
+                WriteBinary(NodeTag::Sub, node);
+            }
+
+            void Visit(const ast::Mult &node) override{
+                WriteBinary(NodeTag::Mult, node);
+            }
+
+            void Visit(const ast::Div &node) override{
+                WriteBinary(NodeTag::Div, node);
+            }
+
+            void Visit(const ast::Or &node) override{
+                WriteBinary(NodeTag::Or, node);
+            }
+
+            void Visit(const ast::And &node) override{
+                WriteBinary(NodeTag::And, node);
+            }
+
+            void Visit(const ast::Not &node) override{
+                WriteTag(NodeTag::Not);
+                WriteNode(node.GetArg().get());
+            }
+
+            void Visit(const ast::Compound &node) override{
+                WriteTag(NodeTag::Compound);
+                WriteNodes(node.GetStatements());
+            }
+
+            void Visit(const ast::MethodBody &node) override{
+                WriteTag(NodeTag::MethodBody);
+                WriteNode(&node.GetBody());
+            }
+
+            void Visit(const ast::Return &node) override{
+                WriteTag(NodeTag::Return);
+                WriteNode(&node.GetStatement());
+            }
+
+            void Visit(const ast::ClassDefinition &node) override{
+                WriteTag(NodeTag::ClassDefinition);
+                WriteClass(*node.GetClass().TryAs<runtime::Class>());
+            }
+
+            void Visit(const ast::IfElse &node) override{
+                WriteTag(NodeTag::IfElse);
+                WriteNode(&node.GetCondition());
+                WriteNode(&node.GetIfBody());
+                WriteNode(node.GetElseBody());
+            }
+
+            void Visit(const ast::Comparison &node) override{
+                const auto *function = node.GetComparator().target<ComparatorFunction>();
+                const auto *known = function != nullptr
+                                        ? std::find(std::begin(COMPARATORS), std::end(COMPARATORS), *function)
+                                        : std::end(COMPARATORS);
+                if (known == std::end(COMPARATORS)){
+                    throw ImageError("ERROR:comparison with a custom comparator cannot be saved"s);
+                }
+                WriteBinary(NodeTag::Comparison, node);
+                WriteValue(static_cast<uint8_t>(known - std::begin(COMPARATORS)));
+            }
+
+            void VisitOpaque(const ast::Statement & /*node*/) override{
+                throw ImageError("ERROR:statement cannot be saved to a program image"s);
+            }
+
+        private:
+            std::string body_;
+            // Номера имён в таблице SymbolTable в порядке их появления в образе
+            std::vector<uint32_t> names_;
+            std::unordered_map<uint32_t, uint32_t> name_indexes_;
+            std::vector<const runtime::Class *> classes_;
+            std::unordered_map<const runtime::Class *, uint32_t> class_indexes_;
+
+            template <typename T>
+            static void AppendValue(std::string &out, T value){
+                out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+            }
+
+            template <typename T>
+            void WriteValue(T value){
+                AppendValue(body_, value);
+            }
+
+            void WriteTag(NodeTag tag){
+                WriteValue(static_cast<uint8_t>(tag));
+            }
+
+            void WriteString(std::string_view value){
+                WriteValue(static_cast<uint32_t>(value.size()));
+                body_ += value;
+            }
+
+            void WriteName(symbols::Symbol name){
+                const auto [it, inserted] =
+                    name_indexes_.emplace(name.GetId(), static_cast<uint32_t>(names_.size()));
+                if (inserted){
+                    names_.push_back(name.GetId());
+                }
+                WriteValue(it->second);
+            }
+
+            template <typename Names>
+            void WriteNames(const Names &names){
+                WriteValue(static_cast<uint32_t>(names.size()));
+                for (const symbols::Symbol name : names){
+                    WriteName(name);
+                }
+            }
+
+            void WriteClass(const runtime::Class &cls){
+                const auto it = class_indexes_.find(&cls);
+                if (it == class_indexes_.end()){
+                    throw ImageError("ERROR:class "s + cls.GetName() + " is not declared in the program"s);
+                }
+                WriteValue(it->second);
+            }
+
+            void WriteNode(const ast::Statement *node){
+                if (node == nullptr){
+                    WriteTag(NodeTag::Null);
+                    return;
+                }
+                node->Accept(*this);
+            }
+
+            void WriteNodes(const ast::StatementList &nodes){
+                WriteValue(static_cast<uint32_t>(nodes.size()));
+                for (const auto &node : nodes){
+                    WriteNode(node.get());
+                }
+            }
+
+            void WriteBinary(NodeTag tag, const ast::BinaryOperation &node){
+                WriteTag(tag);
+                WriteNode(node.GetLhs().get());
+                WriteNode(node.GetRhs().get());
+            }
+
+            // Родительский класс получает номер раньше наследника
+            void AddClass(const runtime::Class &cls){
+                if (class_indexes_.count(&cls) != 0){
+                    return;
+                }
+                if (cls.GetParent() != nullptr){
+                    AddClass(*cls.GetParent());
+                }
+                class_indexes_.emplace(&cls, static_cast<uint32_t>(classes_.size()));
+                classes_.push_back(&cls);
+            }
+        };
+
+        class ImageReader{
+        public:
+            explicit ImageReader(std::string_view data)
+                : data_(data){
+            }
+
+            ParsedProgram Read(std::string_view source){
+                if (ReadBytes(sizeof(MAGIC)) != std::string_view(MAGIC, sizeof(MAGIC)) ||
+                    ReadValue<uint32_t>() != FORMAT_VERSION || ReadValue<uint32_t>() != BYTE_ORDER_MARK){
+                    throw ImageError("ERROR:unsupported program image format"s);
+                }
+                if (ReadValue<uint64_t>() != HashSource(source) || ReadValue<uint64_t>() != source.size() ||
+                    ReadBytes(source.size()) != source){
+                    throw ImageError("ERROR:program image belongs to another source"s);
+                }
+
+                // Единственная поправка при загрузке: имена из образа заносятся в таблицу имён
+                names_.resize(ReadCount());
+                for (auto &name : names_){
+                    name = symbols::Symbol(ReadBytes(ReadCount()));
+                }
+
+                ParsedProgram &program = program_;
+                const runtime::ArenaScope scope(*program.arena);
+                classes_.resize(ReadCount());
+                for (auto &holder : classes_){
+                    const symbols::Symbol name = ReadName();
+                    const uint32_t parent_index = ReadValue<uint32_t>();
+                    const runtime::Class *parent = nullptr;
+                    if (parent_index != 0){
+                        parent = &ReadClassAt(parent_index - 1);
+                    }
+                    const bool declares_slots = ReadValue<uint8_t>() != 0;
+                    std::vector<symbols::Symbol> slots;
+                    if (declares_slots){
+                        slots = ReadNames();
+                    }
+                    std::vector<runtime::Method> methods(ReadCount());
+                    for (auto &method : methods){
+                        method.name = ReadName();
+                        method.formal_params = ReadNames();
+                        method.local_count = ReadValue<uint32_t>();
+                        if (method.local_count != 0 && method.local_count <= method.formal_params.size()){
+                            throw ImageError("ERROR:invalid method frame in program image"s);
+                        }
+                        local_count_ = method.local_count;
+                        method.body = ReadRequiredNode();
+                        local_count_ = 0;
+                    }
+                    holder = declares_slots
+                                 ? runtime::ObjectHolder::Own(runtime::Class(name.GetName(), std::move(methods),
+                                                                             parent, std::move(slots)))
+                                 : runtime::ObjectHolder::Own(runtime::Class(name.GetName(), std::move(methods), parent));
+                    program.classes.emplace(name, holder);
+                }
+
+                program.code = ReadRequiredNode();
+                if (position_ != data_.size()){
+                    throw ImageError("ERROR:unexpected data at the end of the program image"s);
+                }
+                return std::move(program);
+            }
+
+        private:
+            std::string_view data_;
+            size_t position_ = 0;
+            // Программа объявлена раньше классов: методы классов размещены в её арене
+            ParsedProgram program_;
+            std::vector<symbols::Symbol> names_;
+            std::vector<runtime::ObjectHolder> classes_;
+            // Число слотов кадра метода, тело которого сейчас читается
+            size_t local_count_ = 0;
+
+            std::string_view ReadBytes(size_t size){
+                if (data_.size() - position_ < size){
+                    throw ImageError("ERROR:program image is truncated"s);
+                }
+                const std::string_view bytes = data_.substr(position_, size);
+                position_ += size;
+                return bytes;
+            }
+
+            template <typename T>
+            T ReadValue(){
+                T value;
+                std::memcpy(&value, ReadBytes(sizeof(T)).data(), sizeof(T));
+                return value;
+            }
+
+            // Количество элементов или байтов; каждый элемент занимает в образе хотя бы байт
+            size_t ReadCount(){
+                const auto count = ReadValue<uint32_t>();
+                if (count > data_.size() - position_){
+                    throw ImageError("ERROR:program image is truncated"s);
+                }
+                return count;
+            }
+
+            symbols::Symbol ReadName(){
+                const auto index = ReadValue<uint32_t>();
+                if (index >= names_.size()){
+                    throw ImageError("ERROR:invalid name in program image"s);
+                }
+                return names_[index];
+            }
+
+            std::vector<symbols::Symbol> ReadNames(){
+                std::vector<symbols::Symbol> names(ReadCount());
+                for (auto &name : names){
+                    name = ReadName();
+                }
+                return names;
+            }
+
+            // Слот локальной переменной; он должен помещаться в кадр читаемого метода
+            uint32_t ReadSlot(){
+                const auto slot = ReadValue<uint32_t>();
+                if (slot != ast::NO_SLOT && slot >= local_count_){
+                    throw ImageError("ERROR:invalid local variable slot in program image"s);
+                }
+                return slot;
+            }
+
+            void ReadSlotOf(ast::VariableValue &variable){
+                if (const uint32_t slot = ReadSlot(); slot != ast::NO_SLOT){
+                    variable.BindSlot(slot);
+                }
+            }
+
+            const runtime::Class &ReadClassAt(size_t index){
+                if (index >= classes_.size() || !classes_[index]){
+                    throw ImageError("ERROR:invalid class in program image"s);
+                }
+                return *classes_[index].TryAs<runtime::Class>();
+            }
+
+            std::unique_ptr<ast::Statement> ReadRequiredNode(){
+                auto node = ReadNode();
+                if (!node){
+                    throw ImageError("ERROR:missing statement in program image"s);
+                }
+                return node;
+            }
+
+            std::vector<std::unique_ptr<ast::Statement>> ReadNodes(){
+                std::vector<std::unique_ptr<ast::Statement>> nodes(ReadCount());
+                for (auto &node : nodes){
+                    node = ReadRequiredNode();
+                }
+                return nodes;
+            }
+
+            template <typename Node>
+            std::unique_ptr<ast::Statement> ReadBinary(){
+                auto lhs = ReadRequiredNode();
+                return std::make_unique<Node>(std::move(lhs), ReadRequiredNode());
+            }
+
+            std::unique_ptr<ast::Statement> ReadNode(){
+                switch (static_cast<NodeTag>(ReadValue<uint8_t>())){
+                case NodeTag::Null:
+                    return nullptr;
+                case NodeTag::NumericConst:
+                    return std::make_unique<ast::NumericConst>(ReadValue<int32_t>());
+                case NodeTag::StringConst:
+                    return std::make_unique<ast::StringConst>(std::string(ReadBytes(ReadCount())));
+                case NodeTag::BoolConst:
+                    return std::make_unique<ast::BoolConst>(ReadValue<uint8_t>() != 0);
+                case NodeTag::VariableValue:{
+                    auto variable = std::make_unique<ast::VariableValue>(ReadNames());
+                    ReadSlotOf(*variable);
+                    return variable;
+                }
+                case NodeTag::Assignment:{
+                    const symbols::Symbol name = ReadName();
+                    const uint32_t slot = ReadSlot();
+                    auto assignment = std::make_unique<ast::Assignment>(name, ReadRequiredNode());
+                    if (slot != ast::NO_SLOT){
+                        assignment->BindSlot(slot);
+                    }
+                    return assignment;
+                }
+                case NodeTag::FieldAssignment:{
+                    ast::VariableValue object(ReadNames());
+                    ReadSlotOf(object);
+                    const symbols::Symbol field = ReadName();
+                    return std::make_unique<ast::FieldAssignment>(std::move(object), field, ReadRequiredNode());
+                }
+                case NodeTag::None:
+                    return std::make_unique<ast::None>();
+                case NodeTag::Print:
+                    return std::make_unique<ast::Print>(ReadNodes());
+                case NodeTag::MethodCall:{
+                    auto object = ReadRequiredNode();
+                    const symbols::Symbol method = ReadName();
+                    return std::make_unique<ast::MethodCall>(std::move(object), method, ReadNodes());
+                }
+                case NodeTag::NewInstance:{
+                    const runtime::Class &cls = ReadClassAt(ReadValue<uint32_t>());
+                    return std::make_unique<ast::NewInstance>(cls, ReadNodes());
+                }
+                case NodeTag::Stringify:
+                    return std::make_unique<ast::Stringify>(ReadRequiredNode());
+                case NodeTag::Add:
+                    return ReadBinary<ast::Add>();
+                case NodeTag::Sub:
+                    return ReadBinary<ast::Sub>();
+                case NodeTag::Mult:
+                    return ReadBinary<ast::Mult>();
+                case NodeTag::Div:
+                    return ReadBinary<ast::Div>();
+                case NodeTag::Or:
+                    return ReadBinary<ast::Or>();
+                case NodeTag::And:
+                    return ReadBinary<ast::And>();
+                case NodeTag::Not:
+                    return std::make_unique<ast::Not>(ReadRequiredNode());
+                case NodeTag::Compound:{
+                    auto compound = std::make_unique<ast::Compound>();
+                    for (auto &statement : ReadNodes()){
+                        compound->AddStatement(std::move(statement));
+                    }
+                    return compound;
+                }
+                case NodeTag::MethodBody:
+                    return std::make_unique<ast::MethodBody>(ReadRequiredNode());
+                case NodeTag::Return:
+                    return std::make_unique<ast::Return>(ReadRequiredNode());
+                case NodeTag::ClassDefinition:{
+                    const auto index = ReadValue<uint32_t>();
+                    ReadClassAt(index);
+                    return std::make_unique<ast::ClassDefinition>(classes_[index]);
+                }
+                case NodeTag::IfElse:{
+                    auto condition = ReadRequiredNode();
+                    auto if_body = ReadRequiredNode();
+                    return std::make_unique<ast::IfElse>(std::move(condition), std::move(if_body), ReadNode());
+                }
+                case NodeTag::Comparison:{
+                    auto lhs = ReadRequiredNode();
+                    auto rhs = ReadRequiredNode();
+                    const auto comparator = ReadValue<uint8_t>();
+                    if (comparator >= std::size(COMPARATORS)){
+                        throw ImageError("ERROR:invalid comparison in program image"s);
+                    }
+                    return std::make_unique<ast::Comparison>(COMPARATORS[comparator], std::move(lhs),
+                                                             std::move(rhs));
+                }
+                }
+                throw ImageError("ERROR:invalid statement in program image"s);
+            }
+        };
+    } // namespace
+
+    uint64_t HashSource(std::string_view source){
+        // FNV-1a
+        uint64_t hash = 14695981039346656037ULL;
+        for (const char c : source){
+            hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    std::string WriteImage(const ParsedProgram &program, std::string_view source){
+        return ImageWriter(program.classes).Write(*program.code, source);
+    }
+
+    ParsedProgram ReadImage(std::string_view data, std::string_view source){
+        return ImageReader(data).Read(source);
+    }
+
+    ProgramCache::ProgramCache(std::string directory)
+        : directory_(std::move(directory)){
+    }
+
+    std::optional<ParsedProgram> ProgramCache::Load(std::string_view source) const{
+        try{
+            const parse::MappedFile file(GetImagePath(HashSource(source)));
+            return ReadImage(file.GetData(), source);
+        }
+        catch (const parse::MappedFileError &){
+            return std::nullopt;
+        }
+        catch (const ImageError &){
+            return std::nullopt;
+        }
+    }
+
+    bool ProgramCache::Store(std::string_view source, const ParsedProgram &program) const{
+        std::string image;
+        try{
+            image = WriteImage(program, source);
+        }
+        catch (const ImageError &){
+            return false;
+        }
+
+        std::error_code error;
+        std::filesystem::create_directories(directory_, error);
+        // Образ записывается во временный файл и переименовывается, чтобы параллельно
+        // запущенные интерпретаторы не прочитали недописанный образ
+        const std::string path = GetImagePath(HashSource(source));
+        const std::string temporary_path = path + ".tmp"s + std::to_string(::getpid());
+        {
+            std::ofstream out(temporary_path, std::ios::binary | std::ios::trunc);
+            if (!out.write(image.data(), static_cast<std::streamsize>(image.size()))){
+                std::filesystem::remove(temporary_path, error);
+                return false;
+            }
+        }
+        std::filesystem::rename(temporary_path, path, error);
+        if (error){
+            std::filesystem::remove(temporary_path, error);
+            return false;
+        }
+        return true;
+    }
+
+    std::string ProgramCache::GetImagePath(uint64_t source_hash) const{
+        static constexpr char DIGITS[] = "0123456789abcdef";
+        std::string name(16, '0');
+        for (size_t i = 0; i < name.size(); ++i){
+            name[name.size() - 1 - i] = DIGITS[(source_hash >> (4 * i)) & 0xF];
+        }
+        return directory_ + "/"s + name + ".myimg"s;
+    }
+
+} // namespace image
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "parse.h"
+#include "runtime.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace image
+{
+
+    class ImageError : public std::runtime_error{
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    using ::ParsedProgram;
+
+    // Хеш содержимого исходника, по которому называется файл образа. Хеш не защищён
+    // от совпадений, поэтому образ проверяется по самому исходнику
+    uint64_t HashSource(std::string_view source);
+
+    // Сериализует программу, построенную из source, в двоичный образ.
+    // Образ хранит исходник, таблицу имён, классы (родительские раньше наследников) и дерево программы
+    // в прямом порядке обхода; ссылки на имена и классы записываются номерами.
+    // Если программа содержит инструкции вне ast, выбрасывает ImageError
+    std::string WriteImage(const ParsedProgram &program, std::string_view source);
+
+    // Восстанавливает программу из образа data за один проход, размещая её дерево в арене программы.
+    // Выбрасывает ImageError, если образ повреждён, записан другой версией формата
+    // или построен не из source
+    ParsedProgram ReadImage(std::string_view data, std::string_view source);
+
+    // Каталог с образами программ. Образ хранится в файле, названном по хешу исходника,
+    // и читается одним отображением файла в память. Исходник, с хешем которого совпал
+    // хеш другого исходника, не получает чужой образ
+    class ProgramCache{
+    public:
+        explicit ProgramCache(std::string directory);
+
+        // Возвращает программу из образа для source либо nullopt, если подходящего образа нет
+        [[nodiscard]] std::optional<ParsedProgram> Load(std::string_view source) const;
+
+        // Сохраняет образ программы, построенной из source. Возвращает false,
+        // если программу нельзя сериализовать или записать образ не удалось
+        bool Store(std::string_view source, const ParsedProgram &program) const;
+
+    private:
+        std::string directory_;
+
+        [[nodiscard]] std::string GetImagePath(uint64_t source_hash) const;
+    };
+
+} // namespace image
@@ -1,6 +1,9 @@
 #include "runtime.h"
+#include "arena.h"
+#include "statement_visitor.h"
 
 #include <cassert>
+#include <mutex>
 #include <optional>
 #include <sstream>
 #include <algorithm>
@@ -8,9 +11,16 @@
 #include <string_view>
 using namespace std;
 namespace  {
-const std::string STR_METHOD = "__str__"s;
-const std::string EQUAL_METHOD  = "__eq__"s;
-const std::string LESS_METHOD  = "__lt__"s;
+const symbols::Symbol STR_METHOD = "__str__"sv;
+const symbols::Symbol EQUAL_METHOD  = "__eq__"sv;
+const symbols::Symbol LESS_METHOD  = "__lt__"sv;
+const symbols::Symbol SELF = "self"sv;
+
+// Номер следующего создаваемого класса. Классы могут создаваться в разных потоках
+std::atomic<uint64_t> next_class_id{1};
+
+// Защищает переходы между формами экземпляров, общими для всех потоков
+std::mutex shape_transitions_mutex;
 
 }
 namespace runtime
@@ -25,18 +35,18 @@ bool less(const ObjectHolder &lhs, const ObjectHolder &rhs){
     return   lhs.TryAs<Type>()->GetValue() < rhs.TryAs<Type>()->GetValue();;
 }
 
-    ObjectHolder::ObjectHolder(std::shared_ptr<Object> data)
-        : data_(std::move(data))
+    ObjectHolder::ObjectHolder(Value value)
+        : value_(std::move(value))
     {
     }
 
     void ObjectHolder::AssertIsValid() const{
-        assert(data_ != nullptr);
+        assert(Get() != nullptr);
     }
 
     ObjectHolder ObjectHolder::Share(Object &object){
-        // Возвращаем невладеющий shared_ptr (его deleter ничего не делает)
-        return ObjectHolder(std::shared_ptr<Object>(&object, [](auto * /*p*/) { /* do nothing */ }));
+        // Невладеющий ObjectHolder не меняет счётчик ссылок объекта
+        return ObjectHolder(Value(std::in_place_type<Object *>, &object));
     }
 
     ObjectHolder ObjectHolder::None(){
@@ -53,96 +63,467 @@ bool less(const ObjectHolder &lhs, const ObjectHolder &rhs){
         return Get();
     }
 
-    Object *ObjectHolder::Get() const{
-        return data_.get();
-    }
-
     ObjectHolder::operator bool() const{
         return Get() != nullptr;
     }
 
-    bool IsTrue(const ObjectHolder &object){
+    void Executable::Accept(ast::StatementVisitor &visitor) const{
+        visitor.VisitOpaque(*this);
+    }
 
-        if (const auto* ptr = object.TryAs<Number>()){
-            return ptr->GetValue() != 0;
-        }
-        else if (const auto* ptr = object.TryAs<String>()){
-            return !ptr->GetValue().empty();
+    namespace
+    {
+        struct alignas(std::max_align_t) NodeHeader{
+            std::pmr::memory_resource *resource;
+        };
+    } // namespace
+
+    void *Executable::operator new(std::size_t size){
+        std::pmr::memory_resource *resource = CurrentResource();
+        void *memory = resource->allocate(sizeof(NodeHeader) + size, alignof(NodeHeader));
+        return new (memory) NodeHeader{resource} + 1;
+    }
+
+    void Executable::operator delete(void *ptr, std::size_t size) noexcept{
+        if (ptr == nullptr){
+            return;
         }
-        else if (const auto* ptr = object.TryAs<Bool>()){
-            return ptr->GetValue() == true;
-        }else{
-            return false;
+        NodeHeader *header = static_cast<NodeHeader *>(ptr) - 1;
+        // Для арены освобождение ничего не делает: память вернётся вместе со всей ареной
+        header->resource->deallocate(header, sizeof(NodeHeader) + size, alignof(NodeHeader));
+    }
+
+    bool IsTrue(const ObjectHolder &object){
+        switch (object.GetType()){
+            case ObjectType::Number:
+                return object.TryAs<Number>()->GetValue() != 0;
+            case ObjectType::String:
+                return !object.TryAs<String>()->GetValue().empty();
+            case ObjectType::Bool:
+                return object.TryAs<Bool>()->GetValue();
+            default:
+                return false;
         }
     }
 
     void ClassInstance::Print(std::ostream &os, Context &context){
-        if (HasMethod(STR_METHOD, 0))
-            Call(STR_METHOD, {}, context).Get()->Print(os, context);
-        else
+        MethodCache str_cache(STR_METHOD);
+        Print(os, context, str_cache);
+    }
+
+    void ClassInstance::Print(std::ostream &os, Context &context, MethodCache &str_cache){
+        if (const Method *method = str_cache.Find(class_, 0)){
+            CallArguments args(context, 0);
+            Call(*method, args, context).Get()->Print(os, context);
+        }else{
             os << this;
+        }
     }
 
-    bool ClassInstance::HasMethod(const std::string &method, size_t argument_count) const{
+    bool ClassInstance::HasMethod(symbols::Symbol method, size_t argument_count) const{
      const runtime::Method* const method_ptr = class_.GetMethod(method);
         return method_ptr != nullptr && method_ptr->formal_params.size() == argument_count;
     }
 
-    Closure &ClassInstance::Fields(){
+    InstanceFields &ClassInstance::Fields(){
         return fields_;
     }
 
-    const Closure &ClassInstance::Fields() const{
+    const InstanceFields &ClassInstance::Fields() const{
         return fields_;
     }
 
+    const Shape &Shape::Empty(){
+        static const Shape empty;
+        return empty;
+    }
+
+    Shape::Shape(const Shape &parent, symbols::Symbol name)
+        : names_(parent.names_){
+        names_.push_back(name);
+        if (names_.size() > LINEAR_SEARCH_LIMIT){
+            for (size_t slot = 0; slot < names_.size(); ++slot){
+                index_.emplace(names_[slot], slot);
+            }
+        }
+    }
+
+    size_t Shape::Find(symbols::Symbol name) const{
+        if (names_.size() > LINEAR_SEARCH_LIMIT){
+            const auto it = index_.find(name);
+            return it != index_.end() ? it->second : NO_SLOT;
+        }
+        for (size_t slot = 0; slot < names_.size(); ++slot){
+            if (names_[slot] == name){
+                return slot;
+            }
+        }
+        return NO_SLOT;
+    }
+
+    const Shape &Shape::AddField(symbols::Symbol name) const{
+        assert(Find(name) == NO_SLOT);
+        const std::lock_guard lock(shape_transitions_mutex);
+        std::unique_ptr<Shape> &child = transitions_[name];
+        if (!child){
+            child.reset(new Shape(*this, name));
+        }
+        return *child;
+    }
+
+    InstanceFields::InstanceFields(const Shape &layout, bool fixed)
+        : shape_(&layout)
+        , values_(layout.GetFieldCount())
+        , assigned_(layout.GetFieldCount(), false)
+        , unassigned_count_(layout.GetFieldCount())
+        , fixed_(fixed){
+    }
+
+    InstanceFields::InstanceFields(InstanceFields &&other) noexcept
+        : shape_(std::exchange(other.shape_, &Shape::Empty()))
+        , values_(std::move(other.values_))
+        , assigned_(std::move(other.assigned_))
+        , unassigned_count_(std::exchange(other.unassigned_count_, 0))
+        , fixed_(other.fixed_){
+        other.values_.clear();
+        other.assigned_.clear();
+    }
+
+    InstanceFields &InstanceFields::operator=(InstanceFields &&other) noexcept{
+        if (this != &other){
+            shape_ = std::exchange(other.shape_, &Shape::Empty());
+            values_ = std::move(other.values_);
+            other.values_.clear();
+            assigned_ = std::move(other.assigned_);
+            other.assigned_.clear();
+            unassigned_count_ = std::exchange(other.unassigned_count_, 0);
+            fixed_ = other.fixed_;
+        }
+        return *this;
+    }
+
+    ObjectHolder &InstanceFields::operator[](symbols::Symbol name){
+        const size_t slot = shape_->Find(name);
+        if (slot != Shape::NO_SLOT){
+            return AssignSlot(slot);
+        }
+        return Append(shape_->AddField(name));
+    }
+
+    InstanceFields::iterator InstanceFields::find(symbols::Symbol name){
+        const size_t slot = shape_->Find(name);
+        return {this, values_.data(), slot != Shape::NO_SLOT && IsAssigned(slot) ? slot : values_.size()};
+    }
+
+    InstanceFields::const_iterator InstanceFields::find(symbols::Symbol name) const{
+        const size_t slot = shape_->Find(name);
+        return {this, values_.data(), slot != Shape::NO_SLOT && IsAssigned(slot) ? slot : values_.size()};
+    }
+
+    ObjectHolder &InstanceFields::at(symbols::Symbol name){
+        const size_t slot = shape_->Find(name);
+        if (slot == Shape::NO_SLOT || !IsAssigned(slot)){
+            throw std::out_of_range("ERROR:Accessing a non-existent field"s);
+        }
+        return values_[slot];
+    }
+
+    const ObjectHolder &InstanceFields::at(symbols::Symbol name) const{
+        const size_t slot = shape_->Find(name);
+        if (slot == Shape::NO_SLOT || !IsAssigned(slot)){
+            throw std::out_of_range("ERROR:Accessing a non-existent field"s);
+        }
+        return values_[slot];
+    }
+
+    void InstanceFields::clear(){
+        // Значения разрушаются уже после того, как объект остался без полей:
+        // их деструкторы могут снова обратиться к этому объекту
+        std::vector<ObjectHolder> values = std::move(values_);
+        values_.clear();
+        assigned_.clear();
+        unassigned_count_ = 0;
+        shape_ = &Shape::Empty();
+    }
+
+    ObjectHolder &InstanceFields::Append(const Shape &shape){
+        assert(shape.GetFieldCount() == values_.size() + 1);
+        if (fixed_){
+            throw std::runtime_error("ERROR:field "s + shape.GetFieldName(values_.size()).GetName() +
+                                     " is not declared in __slots__"s);
+        }
+        shape_ = &shape;
+        return values_.emplace_back();
+    }
+
     ClassInstance::ClassInstance(const Class &cls)
-        : class_(cls){
+        : Object(ObjectType::ClassInstance)
+        , class_(cls)
+        , fields_(cls.GetLayout(), cls.IsLayoutFixed()){
+    }
+
+    ClassInstance::ClassInstance(const ClassInstance &other)
+        : Object(other)
+        , class_(other.class_)
+        , fields_(other.fields_){
+    }
+
+    ClassInstance::ClassInstance(ClassInstance &&other) noexcept
+        : Object(other)
+        , class_(other.class_)
+        , fields_(std::move(other.fields_)){
+    }
+
+    ClassInstance::~ClassInstance(){
+        if (collector_ != nullptr){
+            collector_->Forget(*this);
+        }
+    }
+
+    void TrackInstance(ClassInstance &instance){
+        CycleCollector::Instance().Track(instance);
+    }
+
+    CycleCollector &CycleCollector::Instance(){
+        thread_local CycleCollector collector;
+        return collector;
+    }
+
+    CycleCollector::~CycleCollector(){
+        const std::lock_guard lock(mutex_);
+        for (ClassInstance *instance : instances_){
+            instance->collector_ = nullptr;
+            instance->collector_index_ = ClassInstance::NOT_TRACKED;
+        }
+    }
+
+    void CycleCollector::Track(ClassInstance &instance){
+        bool collect = false;
+        {
+            const std::lock_guard lock(mutex_);
+            instance.collector_ = this;
+            instance.collector_index_ = instances_.size();
+            instances_.push_back(&instance);
+            ++created_since_collection_;
+            collect = threshold_ != 0 && created_since_collection_ >= std::max(threshold_, survived_last_collection_);
+        }
+        if (collect){
+            Collect();
+        }
+    }
+
+    void CycleCollector::Forget(ClassInstance &instance){
+        const std::lock_guard lock(mutex_);
+        assert(instance.collector_ == this && instances_[instance.collector_index_] == &instance);
+        ClassInstance *const last = instances_.back();
+        instances_[instance.collector_index_] = last;
+        last->collector_index_ = instance.collector_index_;
+        instances_.pop_back();
+        instance.collector_ = nullptr;
+        instance.collector_index_ = ClassInstance::NOT_TRACKED;
+    }
+
+    ClassInstance *CycleCollector::GetTracked(const ObjectHolder &value) const{
+        if (!value.IsOwning()){
+            return nullptr;
+        }
+        auto *instance = value.TryAs<ClassInstance>();
+        return instance != nullptr && instance->collector_ == this ? instance : nullptr;
+    }
+
+    size_t CycleCollector::Collect(){
+        std::unique_lock lock(mutex_);
+        // Освобождение экземпляров не создаёт новых, но на всякий случай сборка не вкладывается
+        if (collecting_){
+            return 0;
+        }
+        collecting_ = true;
+        const auto start = std::chrono::steady_clock::now();
+
+        // Ссылки на каждый экземпляр, кроме ссылок из полей отслеживаемых экземпляров
+        const size_t count = instances_.size();
+        std::vector<uint32_t> external(count);
+        for (size_t i = 0; i < count; ++i){
+            external[i] = instances_[i]->ref_count_;
+        }
+        for (const ClassInstance *instance : instances_){
+            for (const auto &[name, value] : instance->fields_){
+                if (const ClassInstance *target = GetTracked(value)){
+                    --external[target->collector_index_];
+                }
+            }
+        }
+
+        // Экземпляры с внешними ссылками и всё, что достижимо из них по полям
+        std::vector<bool> reachable(count);
+        std::vector<const ClassInstance *> pending;
+        for (size_t i = 0; i < count; ++i){
+            if (external[i] != 0){
+                reachable[i] = true;
+                pending.push_back(instances_[i]);
+            }
+        }
+        while (!pending.empty()){
+            const ClassInstance *instance = pending.back();
+            pending.pop_back();
+            for (const auto &[name, value] : instance->fields_){
+                const ClassInstance *target = GetTracked(value);
+                if (target != nullptr && !reachable[target->collector_index_]){
+                    reachable[target->collector_index_] = true;
+                    pending.push_back(target);
+                }
+            }
+        }
+
+        // Недостижимые экземпляры удерживаются, пока очищаются их поля, и освобождаются все разом.
+        // Освобождаемые экземпляры удаляют себя из списка, поэтому список разблокируется
+        std::vector<ObjectRef> garbage;
+        for (size_t i = 0; i < count; ++i){
+            if (!reachable[i]){
+                garbage.emplace_back(instances_[i]);
+            }
+        }
+        lock.unlock();
+        for (const ObjectRef &ref : garbage){
+            static_cast<ClassInstance *>(ref.Get())->fields_.clear();
+        }
+        const size_t collected = garbage.size();
+        garbage.clear();
+
+        lock.lock();
+        const auto pause = std::chrono::steady_clock::now() - start;
+        ++statistics_.collections;
+        statistics_.collected += collected;
+        statistics_.last_pause = pause;
+        statistics_.max_pause = std::max(statistics_.max_pause, statistics_.last_pause);
+        statistics_.total_pause += pause;
+        created_since_collection_ = 0;
+        survived_last_collection_ = instances_.size();
+        collecting_ = false;
+        return collected;
     }
 
-    ObjectHolder ClassInstance::Call(const std::string &method,
+    ObjectHolder ClassInstance::Call(symbols::Symbol method,
                                      const std::vector<ObjectHolder> &actual_args,
                                      Context &context){
-        if (!HasMethod(method, actual_args.size())){
+        CallArguments args(context, actual_args.size());
+        for (size_t i = 0; i < actual_args.size(); ++i){
+            args[i] = actual_args[i];
+        }
+        return Call(method, args, context);
+    }
+
+    ObjectHolder ClassInstance::Call(symbols::Symbol method, CallArguments &actual_args, Context &context){
+        const runtime::Method* const method_ptr = class_.GetMethod(method);
+        if (method_ptr == nullptr || method_ptr->formal_params.size() != actual_args.size()){
             throw std::runtime_error("ERROR:Такого метода не существует"s);
         }
+        return Call(*method_ptr, actual_args, context);
+    }
+
+    ObjectHolder ClassInstance::Call(const Method &method, CallArguments &actual_args, Context &context){
+        assert(method.formal_params.size() == actual_args.size());
+        if (method.local_count != 0){
+            MethodFrame frame(method, *this, actual_args, context);
+            runtime::Closure unused;
+            return method.body->Execute(unused, context);
+        }
         runtime::Closure args;
-        args["self"s] = ObjectHolder::Share(*this);
-        const runtime::Method* const method_ptr = class_.GetMethod(method);
+        args[SELF] = ObjectHolder::Share(*this);
         for (size_t i = 0; i < actual_args.size(); ++i){
-            args[method_ptr->formal_params[i]] = actual_args[i];
+            args[method.formal_params[i]] = *actual_args[i];
         }
-        return method_ptr->body->Execute(args, context);
+        return method.body->Execute(args, context);
     }
 
-    Class::Class(std::string name, std::vector<Method> methods, const Class *parent)
-        : name_(std::move(name))
-        , parent_(parent)
-    {
-                std::set<std::string_view> tmp;
-                for(const auto& method: methods){
-            if(!tmp.insert(method.name).second){
-                throw std::runtime_error("ERROR:method overloading is not supported"s);
+    size_t FrameStack::Push(size_t size){
+        const size_t base = top_;
+        top_ += size;
+        if (top_ > slots_.size()){
+            slots_.resize(std::max(top_, slots_.size() * 2));
+            if (current_base_ != NO_FRAME){
+                current_ = slots_.data() + current_base_;
             }
         }
-        methods_ = std::move(methods);
+        return base;
+    }
+
+    void FrameStack::Pop(size_t base){
+        for (size_t i = base; i < top_; ++i){
+            slots_[i].reset();
+        }
+        top_ = base;
+    }
 
+    size_t FrameStack::Enter(size_t base){
+        const size_t previous = current_base_;
+        current_base_ = base;
+        current_ = base == NO_FRAME ? nullptr : slots_.data() + base;
+        return previous;
     }
 
-    const Method *Class::GetMethod(const std::string &name) const{
+    CallArguments::CallArguments(Context &context, size_t count)
+        : frames_(context.GetFrames())
+        , base_(frames_.Push(count + 1))
+        , count_(count){
+    }
 
-        auto it = std::find_if(methods_.begin(), methods_.end(), [&name](const auto &method){ return method.name == name; });
+    CallArguments::~CallArguments(){
+        frames_.Pop(base_);
+    }
 
+    MethodFrame::MethodFrame(const Method &method, ClassInstance &self, CallArguments &args,
+                             Context &context)
+        : frames_(context.GetFrames()){
+        // Аргументы лежат на вершине стека, поэтому остальные слоты кадра продолжают их
+        assert(frames_.GetTop() == args.base_ + args.count_ + 1);
+        frames_.Push(method.local_count - args.count_ - 1);
+        frames_[args.base_] = ObjectHolder::Share(self);
+        previous_frame_ = frames_.Enter(args.base_);
+    }
 
-        if (it != methods_.end()){
-            return &*it;
-        }else if(parent_ != nullptr){
+    MethodFrame::~MethodFrame(){
+        frames_.Enter(previous_frame_);
+    }
 
-            auto method_ptr = parent_->GetMethod(name);
-            if (method_ptr != nullptr)
-                return method_ptr;
+    Class::Class(std::string name, std::vector<Method> methods, const Class *parent)
+        : Object(ObjectType::Class)
+        , id_(next_class_id.fetch_add(1, std::memory_order_relaxed))
+        , name_(std::move(name))
+        , methods_(std::move(methods))
+        , parent_(parent)
+        , layout_(parent != nullptr ? &parent->GetLayout() : &Shape::Empty())
+    {
+        if (parent_ != nullptr){
+            method_table_ = parent_->method_table_;
+        }
+        std::set<uint32_t> own;
+        for (const auto &method : methods_){
+            if (!own.insert(method.name.GetId()).second){
+                throw std::runtime_error("ERROR:method overloading is not supported"s);
+            }
+            method_table_[method.name] = &method;
         }
-        return nullptr;
+    }
+
+    Class::Class(std::string name, std::vector<Method> methods, const Class *parent,
+                 std::vector<symbols::Symbol> slots)
+        : Class(std::move(name), std::move(methods), parent)
+    {
+        slots_ = std::move(slots);
+        declares_slots_ = true;
+        layout_fixed_ = parent_ == nullptr || parent_->IsLayoutFixed();
+        for (const symbols::Symbol slot : slots_){
+            if (layout_->Find(slot) != Shape::NO_SLOT){
+                throw std::runtime_error("ERROR:field "s + slot.GetName() + " is declared twice in __slots__"s);
+            }
+            layout_ = &layout_->AddField(slot);
+        }
+    }
+
+    const Method *Class::GetMethod(symbols::Symbol name) const{
+        const auto it = method_table_.find(name);
+        return it != method_table_.end() ? it->second : nullptr;
     }
 
     [[nodiscard]] const std::string &Class::GetName() const{
@@ -157,58 +538,104 @@ bool less(const ObjectHolder &lhs, const ObjectHolder &rhs){
         os << (GetValue() ? "True"sv : "False"sv);
     }
 
-    bool Equal(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context){
-        if (lhs.TryAs<Number>() && rhs.TryAs<Number>()){
-            return equal<Number>(lhs,rhs);            
+    void PrintValue(const ObjectHolder &value, std::ostream &os, Context &context, MethodCache &str_cache){
+        if (auto *instance = value.TryAs<ClassInstance>()){
+            instance->Print(os, context, str_cache);
+        }else if (value){
+            value->Print(os, context);
+        }else{
+            os << "None"sv;
         }
-        else if (lhs.TryAs<String>() && rhs.TryAs<String>()){
-            return equal<String>(lhs,rhs);
+    }
 
+    ComparisonCaches::ComparisonCaches()
+        : equal_(EQUAL_METHOD)
+        , less_(LESS_METHOD){
+    }
+
+    bool ComparisonCaches::Equal(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context){
+        switch (TypePair(lhs.GetType(), rhs.GetType())){
+            case TypePair(ObjectType::Number, ObjectType::Number):
+                return equal<Number>(lhs,rhs);
+            case TypePair(ObjectType::String, ObjectType::String):
+                return equal<String>(lhs,rhs);
+            case TypePair(ObjectType::Bool, ObjectType::Bool):
+                return equal<Bool>(lhs,rhs);
+            case TypePair(ObjectType::None, ObjectType::None):
+                return true;
+            default:
+                break;
         }
-        else if (lhs.TryAs<Bool>() && rhs.TryAs<Bool>()){
-             return equal<Bool>(lhs,rhs);            
-        }
-        else if (!lhs && !rhs){
-            return true;
+        if (auto *instance = lhs.TryAs<ClassInstance>()){
+            if (const Method *method = equal_.Find(instance->GetClass(), 1)){
+                CallArguments args(context, 1);
+                args[0] = rhs;
+                return instance->Call(*method, args, context).TryAs<Bool>()->GetValue();
+            }
         }
-        else if (lhs.TryAs<ClassInstance>() && lhs.TryAs<ClassInstance>()->HasMethod(EQUAL_METHOD, 1)){
-            return lhs.TryAs<ClassInstance>()->Call(EQUAL_METHOD, {rhs}, context).TryAs<Bool>()->GetValue();
-        }else{
         throw std::runtime_error("ERROR:These objects cannot be compared"s);
-        }
     }
 
-    bool Less(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context)
+    bool ComparisonCaches::Less(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context)
     {
-        if (lhs.TryAs<Number>() && rhs.TryAs<Number>()){
-            return less<Number>(lhs,rhs);            
-        }
-        else if (lhs.TryAs<String>() && rhs.TryAs<String>()){
-            return less<String>(lhs,rhs);           
-        }
-        else if (lhs.TryAs<Bool>() && rhs.TryAs<Bool>()){
-            return less<Bool>(lhs,rhs);            
+        switch (TypePair(lhs.GetType(), rhs.GetType())){
+            case TypePair(ObjectType::Number, ObjectType::Number):
+                return less<Number>(lhs,rhs);
+            case TypePair(ObjectType::String, ObjectType::String):
+                return less<String>(lhs,rhs);
+            case TypePair(ObjectType::Bool, ObjectType::Bool):
+                return less<Bool>(lhs,rhs);
+            default:
+                break;
         }
-        else if (lhs.TryAs<ClassInstance>() && lhs.TryAs<ClassInstance>()->HasMethod(LESS_METHOD, 1)){
-            return lhs.TryAs<ClassInstance>()->Call(LESS_METHOD, {rhs}, context).TryAs<Bool>()->GetValue();
+        if (auto *instance = lhs.TryAs<ClassInstance>()){
+            if (const Method *method = less_.Find(instance->GetClass(), 1)){
+                CallArguments args(context, 1);
+                args[0] = rhs;
+                return instance->Call(*method, args, context).TryAs<Bool>()->GetValue();
+            }
         }
         throw std::runtime_error("ERROR:These objects cannot be compared by less"s);
     }
 
-    bool NotEqual(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context){
+    bool ComparisonCaches::NotEqual(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context){
         return !Equal(lhs, rhs, context);
     }
 
-    bool Greater(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context){
+    bool ComparisonCaches::Greater(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context){
         return !Less(lhs, rhs, context) && !Equal(lhs, rhs, context);
     }
 
-    bool LessOrEqual(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context){
+    bool ComparisonCaches::LessOrEqual(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context){
         return !Greater(lhs, rhs, context);
     }
 
-    bool GreaterOrEqual(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context){
+    bool ComparisonCaches::GreaterOrEqual(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context){
         return !Less(lhs, rhs, context);
     }
 
+    bool Equal(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context){
+        return ComparisonCaches().Equal(lhs, rhs, context);
+    }
+
+    bool Less(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context){
+        return ComparisonCaches().Less(lhs, rhs, context);
+    }
+
+    bool NotEqual(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context){
+        return ComparisonCaches().NotEqual(lhs, rhs, context);
+    }
+
+    bool Greater(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context){
+        return ComparisonCaches().Greater(lhs, rhs, context);
+    }
+
+    bool LessOrEqual(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context){
+        return ComparisonCaches().LessOrEqual(lhs, rhs, context);
+    }
+
+    bool GreaterOrEqual(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context){
+        return ComparisonCaches().GreaterOrEqual(lhs, rhs, context);
+    }
+
 } // namespace runtime
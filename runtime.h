@@ -1,45 +1,237 @@
 #pragma once
 
+#include "symbol.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
 #include <sstream>
 #include <string>
 #include <unordered_map>
+#include <variant>
 #include <vector>
 #include <set>
 
+namespace ast
+{
+    class StatementVisitor;
+} // namespace ast
+
 namespace runtime
 {
 
-    // Контекст исполнения инструкций Mython
-    class Context{
-    public:
-        // Возвращает поток вывода для команд print
-        virtual std::ostream &GetOutputStream() = 0;
+    class Context;
+    class Class;
+    class ClassInstance;
+    class Bool;
+    class CycleCollector;
+    template <typename T>
+    class ValueObject;
 
-    protected:
-        ~Context() = default;
+    // Тип объекта Mython. Операции выбирают реализацию по типам операндов без обращения к RTTI
+    enum class ObjectType : uint8_t{
+        None,
+        Number,
+        String,
+        Bool,
+        Class,
+        ClassInstance,
+        // Прочие наследники Object
+        Other,
     };
 
+    inline constexpr size_t OBJECT_TYPE_COUNT = static_cast<size_t>(ObjectType::Other) + 1;
+
+    // Номер пары типов операндов бинарной операции. Выбор по паре типов
+    // в switch компилируется в один переход по таблице
+    constexpr size_t TypePair(ObjectType lhs, ObjectType rhs){
+        return static_cast<size_t>(lhs) * OBJECT_TYPE_COUNT + static_cast<size_t>(rhs);
+    }
+
+    // Тип объектов класса T
+    template <typename T>
+    inline constexpr ObjectType OBJECT_TYPE_OF = ObjectType::Other;
+    template <>
+    inline constexpr ObjectType OBJECT_TYPE_OF<ValueObject<int>> = ObjectType::Number;
+    template <>
+    inline constexpr ObjectType OBJECT_TYPE_OF<ValueObject<std::string>> = ObjectType::String;
+    template <>
+    inline constexpr ObjectType OBJECT_TYPE_OF<Bool> = ObjectType::Bool;
+    template <>
+    inline constexpr ObjectType OBJECT_TYPE_OF<Class> = ObjectType::Class;
+    template <>
+    inline constexpr ObjectType OBJECT_TYPE_OF<ClassInstance> = ObjectType::ClassInstance;
+
+#ifdef MYTHON_ATOMIC_REFCOUNT
+    // Счётчик ссылок объектов, которые могут разделяться между потоками
+    using RefCount = std::atomic<uint32_t>;
+#else
+    // Интерпретатор работает в одном потоке, поэтому счётчику ссылок не нужны атомарные операции
+    using RefCount = uint32_t;
+#endif
+
     // Базовый класс для всех объектов языка Mython
     class Object{
     public:
         virtual ~Object() = default;
         // выводит в os своё представление в виде строки
         virtual void Print(std::ostream &os, Context &context) = 0;
+
+        [[nodiscard]] ObjectType GetType() const{
+            return type_;
+        }
+
+    protected:
+        Object() = default;
+        explicit Object(ObjectType type)
+            : type_(type){
+        }
+
+        // Копия объекта — новый объект, и ссылок на неё ещё нет
+        Object(const Object &other)
+            : type_(other.type_){
+        }
+
+        Object &operator=(const Object &other){
+            type_ = other.type_;
+            return *this;
+        }
+
+    private:
+        friend class ObjectRef;
+        friend class CycleCollector;
+
+        ObjectType type_ = ObjectType::Other;
+        // Число ObjectRef, владеющих объектом
+        RefCount ref_count_{0};
+    };
+
+    // Владеющая ссылка на объект в куче. Число ссылок хранится в самом объекте,
+    // объект удаляется вместе с последней ссылкой
+    class ObjectRef{
+    public:
+        explicit ObjectRef(Object *object) noexcept
+            : object_(object){
+            ++object_->ref_count_;
+        }
+
+        ObjectRef(const ObjectRef &other) noexcept
+            : object_(other.object_){
+            ++object_->ref_count_;
+        }
+
+        ObjectRef(ObjectRef &&other) noexcept
+            : object_(std::exchange(other.object_, nullptr)){
+        }
+
+        ObjectRef &operator=(ObjectRef other) noexcept{
+            std::swap(object_, other.object_);
+            return *this;
+        }
+
+        ~ObjectRef(){
+            if (object_ != nullptr && --object_->ref_count_ == 0){
+                delete object_;
+            }
+        }
+
+        [[nodiscard]] Object *Get() const noexcept{
+            return object_;
+        }
+
+    private:
+        Object *object_;
+    };
+
+    // Объект-значение, хранящий значение типа T
+    template <typename T>
+    class ValueObject : public Object{
+    public:
+        ValueObject(T v) // NOLINT(google-explicit-constructor,hicpp-explicit-conversions)
+            : Object(OBJECT_TYPE_OF<ValueObject>)
+            , value_(v){
+        }
+
+        void Print(std::ostream &os, [[maybe_unused]] Context &context) override{
+            os << value_;
+        }
+
+        [[nodiscard]] const T &GetValue() const{
+            return value_;
+        }
+
+    protected:
+        ValueObject(T v, ObjectType type)
+            : Object(type)
+            , value_(v){
+        }
+
+    private:
+        T value_;
+    };
+
+    // Строковое значение
+    using String = ValueObject<std::string>;
+    // Числовое значение
+    using Number = ValueObject<int>;
+
+    // Логическое значение
+    class Bool : public ValueObject<bool>
+    {
+    public:
+        Bool(bool v) // NOLINT(google-explicit-constructor,hicpp-explicit-conversions)
+            : ValueObject<bool>(v, ObjectType::Bool){
+        }
+
+        void Print(std::ostream &os, Context &context) override;
     };
 
-    // Специальный класс-обёртка, предназначенный для хранения объекта в Mython-программе
+    // Передаёт экземпляр класса, только что размещённый в куче, сборщику циклических ссылок
+    void TrackInstance(ClassInstance &instance);
+
+    // Специальный класс-обёртка, предназначенный для хранения объекта в Mython-программе.
+    // Числа и логические значения хранятся непосредственно внутри ObjectHolder и не требуют
+    // выделения памяти, остальные объекты размещаются в куче и разделяются копиями ObjectHolder.
+    // Указатели, полученные из ObjectHolder с непосредственным значением, действительны,
+    // пока этот ObjectHolder существует и не перемещён
     class ObjectHolder{
     public:
         // Создаёт пустое значение
         ObjectHolder() = default;
 
+        ObjectHolder(const ObjectHolder &) = default;
+        ObjectHolder &operator=(const ObjectHolder &) = default;
+        // После перемещения исходный ObjectHolder пуст, в том числе если хранил непосредственное значение
+        ObjectHolder(ObjectHolder &&other) noexcept
+            : value_(std::exchange(other.value_, Value())){
+        }
+        ObjectHolder &operator=(ObjectHolder &&other) noexcept{
+            value_ = std::exchange(other.value_, Value());
+            return *this;
+        }
+
         // Возвращает ObjectHolder, владеющий объектом типа T
         // Тип T - конкретный класс-наследник Object.
-        // object копируется или перемещается в кучу
+        // Number и Bool копируются внутрь ObjectHolder, остальные объекты копируются или перемещаются в кучу
         template <typename T>
         [[nodiscard]] static ObjectHolder Own(T &&object){
-            return ObjectHolder(std::make_shared<T>(std::forward<T>(object)));
+            using Type = std::decay_t<T>;
+            if constexpr (std::is_same_v<Type, Number> || std::is_same_v<Type, Bool>){
+                return ObjectHolder(Value(std::in_place_type<Type>, std::forward<T>(object)));
+            }else{
+                auto *stored = new Type(std::forward<T>(object));
+                ObjectHolder holder(Value(std::in_place_type<ObjectRef>, stored));
+                if constexpr (std::is_same_v<Type, ClassInstance>){
+                    TrackInstance(*stored);
+                }
+                return holder;
+            }
         }
 
         // Создаёт ObjectHolder, не владеющий объектом (аналог слабой ссылки)
@@ -53,47 +245,155 @@ namespace runtime
 
         Object *operator->() const;
 
-        [[nodiscard]] Object *Get() const;
+        [[nodiscard]] Object *Get() const{
+            switch (value_.index()){
+                case OWNED_INDEX:
+                    return std::get<OWNED_INDEX>(value_).Get();
+                case SHARED_INDEX:
+                    return std::get<SHARED_INDEX>(value_);
+                case NUMBER_INDEX:
+                    return &std::get<NUMBER_INDEX>(value_);
+                case BOOL_INDEX:
+                    return &std::get<BOOL_INDEX>(value_);
+                default:
+                    return nullptr;
+            }
+        }
 
         // Возвращает указатель на объект типа T либо nullptr, если внутри ObjectHolder не хранится
         // объект данного типа
         template <typename T>
         [[nodiscard]] T *TryAs() const{
-            return dynamic_cast<T *>(this->Get());
+            if constexpr (OBJECT_TYPE_OF<T> != ObjectType::Other){
+                return GetType() == OBJECT_TYPE_OF<T> ? static_cast<T *>(Get()) : nullptr;
+            }else{
+                return dynamic_cast<T *>(Get());
+            }
+        }
+
+        // Возвращает тип хранимого объекта; для пустого ObjectHolder — ObjectType::None
+        [[nodiscard]] ObjectType GetType() const{
+            switch (value_.index()){
+                case NUMBER_INDEX:
+                    return ObjectType::Number;
+                case BOOL_INDEX:
+                    return ObjectType::Bool;
+                case OWNED_INDEX:
+                    return std::get<OWNED_INDEX>(value_).Get()->GetType();
+                case SHARED_INDEX:
+                    return std::get<SHARED_INDEX>(value_)->GetType();
+                default:
+                    return ObjectType::None;
+            }
         }
 
         // Возвращает true, если ObjectHolder не пуст
         explicit operator bool() const;
 
+        // Возвращает true, если ObjectHolder владеет объектом в куче, то есть учтён в его счётчике ссылок
+        [[nodiscard]] bool IsOwning() const{
+            return value_.index() == OWNED_INDEX;
+        }
+
     private:
-        explicit ObjectHolder(std::shared_ptr<Object> data);
+        // Пусто (None), объект в куче, чужой объект (Share) либо непосредственное значение
+        using Value = std::variant<std::monostate, ObjectRef, Object *, Number, Bool>;
+        static constexpr size_t OWNED_INDEX = 1;
+        static constexpr size_t SHARED_INDEX = 2;
+        static constexpr size_t NUMBER_INDEX = 3;
+        static constexpr size_t BOOL_INDEX = 4;
+
+        explicit ObjectHolder(Value value);
         void AssertIsValid() const;
 
-        std::shared_ptr<Object> data_;
+        // Непосредственные значения изменяемы через указатели, полученные из константного ObjectHolder,
+        // так же, как и объекты в куче
+        mutable Value value_;
     };
 
-    // Объект-значение, хранящий значение типа T
-    template <typename T>
-    class ValueObject : public Object{
+    // Таблица символов, связывающая имя объекта с его значением
+    using Closure = std::unordered_map<symbols::Symbol, ObjectHolder>;
+
+    // Слот локальной переменной метода. Пока переменной не присвоено значение, слот пуст
+    using LocalSlot = std::optional<ObjectHolder>;
+
+    // Стек кадров методов. Кадры лежат подряд в одном массиве слотов, который только растёт,
+    // поэтому после того, как стек однажды достиг нужной глубины, вызовы не выделяют память.
+    // Массив может переместиться при росте, поэтому кадры задаются номерами первых слотов
+    class FrameStack{
     public:
-        ValueObject(T v) // NOLINT(google-explicit-constructor,hicpp-explicit-conversions)
-            : value_(v){
+        static constexpr size_t NO_FRAME = static_cast<size_t>(-1);
+
+        // Кладёт на стек size пустых слотов и возвращает номер первого из них
+        size_t Push(size_t size);
+        // Снимает со стека слоты, начиная со слота base, и освобождает их значения
+        void Pop(size_t base);
+
+        [[nodiscard]] LocalSlot &operator[](size_t index){
+            return slots_[index];
         }
 
-        void Print(std::ostream &os, [[maybe_unused]] Context &context) override{
-            os << value_;
+        // Номер первого слота на вершине стека
+        [[nodiscard]] size_t GetTop() const{
+            return top_;
         }
 
-        [[nodiscard]] const T &GetValue() const{
-            return value_;
+        // Делает текущим кадр, начинающийся со слота base, либо снимает текущий кадр,
+        // если base равен NO_FRAME. Возвращает номер прежнего текущего кадра
+        size_t Enter(size_t base);
+
+        // Слоты текущего кадра либо nullptr, если текущего кадра нет
+        [[nodiscard]] LocalSlot *GetCurrent() const{
+            return current_;
         }
 
     private:
-        T value_;
+        std::vector<LocalSlot> slots_;
+        size_t top_ = 0;
+        size_t current_base_ = NO_FRAME;
+        LocalSlot *current_ = nullptr;
     };
 
-    // Таблица символов, связывающая имя объекта с его значением
-    using Closure = std::unordered_map<std::string, ObjectHolder>;
+    // Контекст исполнения инструкций Mython
+    class Context{
+    public:
+        // Возвращает поток вывода для команд print
+        virtual std::ostream &GetOutputStream() = 0;
+
+        // Возвращает стек кадров методов, выполняемых в этом контексте
+        [[nodiscard]] FrameStack &GetFrames(){
+            return frames_;
+        }
+
+        // Возвращает слоты локальных переменных выполняемого метода
+        // либо nullptr, если метод не выполняется
+        [[nodiscard]] LocalSlot *GetLocals() const{
+            return frames_.GetCurrent();
+        }
+
+        // Отмечает выполнение инструкции return. Пока возврат не завершён, инструкции,
+        // содержащие другие инструкции, прекращают выполнение и возвращают результат
+        // последней выполненной инструкции, то есть значение return
+        void BeginReturn(){
+            returning_ = true;
+        }
+
+        [[nodiscard]] bool IsReturning() const{
+            return returning_;
+        }
+
+        // Завершает возврат из метода. Возвращает true, если возврат выполнялся
+        bool EndReturn(){
+            return std::exchange(returning_, false);
+        }
+
+    protected:
+        ~Context() = default;
+
+    private:
+        FrameStack frames_;
+        bool returning_ = false;
+    };
 
     // Проверяет, содержится ли в object значение, приводимое к True
     // Для отличных от нуля чисел, True и непустых строк возвращается true. В остальных случаях - false.
@@ -106,30 +406,74 @@ namespace runtime
         // Выполняет действие над объектами внутри closure, используя context
         // Возвращает результирующее значение либо None
         virtual ObjectHolder Execute(Closure &closure, Context &context) = 0;
-    };
-
-    // Строковое значение
-    using String = ValueObject<std::string>;
-    // Числовое значение
-    using Number = ValueObject<int>;
+        // Передаёт инструкцию обходчику visitor. Инструкции, не входящие в ast,
+        // передаются в visitor.VisitOpaque
+        virtual void Accept(ast::StatementVisitor &visitor) const;
 
-    // Логическое значение
-    class Bool : public ValueObject<bool>
-    {
-    public:
-        using ValueObject<bool>::ValueObject;
-        void Print(std::ostream &os, Context &context) override;
+        // Инструкции размещаются в арене текущей области ArenaScope, если она задана,
+        // иначе — в куче. Перед инструкцией хранится источник её памяти
+        static void *operator new(std::size_t size);
+        static void operator delete(void *ptr, std::size_t size) noexcept;
     };
 
     // Метод класса
     struct Method{
 
         // Имя метода
-        std::string name;
+        symbols::Symbol name;
         // Имена формальных параметров метода
-        std::vector<std::string> formal_params;
+        std::vector<symbols::Symbol> formal_params;
         // Тело метода
         std::unique_ptr<Executable> body;
+        // Число слотов локальных переменных. Слот 0 занимает self, слоты 1..n — параметры,
+        // за ними идут переменные, которым присваивается значение в теле метода.
+        // Если слотов нет, имена в теле метода ищутся в closure
+        size_t local_count = 0;
+    };
+
+    /*
+     * Форма экземпляра класса: упорядоченный список имён его полей. Экземпляры, поля которых
+     * добавлялись в одном порядке, разделяют одну форму и хранят значения полей в массиве
+     * по номерам, которые задаёт форма. Формы образуют дерево переходов: добавление поля
+     * переводит экземпляр в дочернюю форму, которая создаётся при первом таком добавлении.
+     * Формы общие для всех потоков и не удаляются до завершения программы,
+     * поэтому адрес формы можно использовать как ключ кеша
+     */
+    class Shape{
+    public:
+        static constexpr size_t NO_SLOT = static_cast<size_t>(-1);
+
+        Shape(const Shape &) = delete;
+        Shape &operator=(const Shape &) = delete;
+
+        // Форма без полей, с которой начинает каждый экземпляр
+        static const Shape &Empty();
+
+        // Возвращает номер поля name или NO_SLOT, если такого поля нет
+        [[nodiscard]] size_t Find(symbols::Symbol name) const;
+
+        // Возвращает форму с теми же полями и полем name после них
+        [[nodiscard]] const Shape &AddField(symbols::Symbol name) const;
+
+        [[nodiscard]] size_t GetFieldCount() const{
+            return names_.size();
+        }
+
+        [[nodiscard]] symbols::Symbol GetFieldName(size_t slot) const{
+            return names_[slot];
+        }
+
+    private:
+        // Поле формы с большим числом полей ищется по хеш-таблице, с меньшим — перебором
+        static constexpr size_t LINEAR_SEARCH_LIMIT = 8;
+
+        Shape() = default;
+        Shape(const Shape &parent, symbols::Symbol name);
+
+        std::vector<symbols::Symbol> names_;
+        std::unordered_map<symbols::Symbol, size_t> index_;
+        // Дочерние формы по имени добавляемого поля. Защищены общим мьютексом переходов
+        mutable std::unordered_map<symbols::Symbol, std::unique_ptr<Shape>> transitions_;
     };
 
     // Класс
@@ -138,58 +482,522 @@ namespace runtime
         // Создаёт класс с именем name и набором методов methods, унаследованный от класса parent
         // Если parent равен nullptr, то создаётся базовый класс
         explicit Class(std::string name, std::vector<Method> methods, const Class *parent);
+        // Создаёт класс с объявленными полями slots, как __slots__ в Python. Экземпляр получает
+        // поля родителя и поля slots со значением None сразу при создании. Если поля объявлены
+        // у всех предков, набор полей экземпляра фиксирован и добавить другое поле нельзя
+        Class(std::string name, std::vector<Method> methods, const Class *parent,
+              std::vector<symbols::Symbol> slots);
 
-        // Возвращает указатель на метод name или nullptr, если метод с таким именем отсутствует
-        [[nodiscard]] const Method *GetMethod(const std::string &name) const;
+        // Возвращает указатель на метод name или nullptr, если метод с таким именем отсутствует.
+        // Поиск не зависит от числа методов и глубины иерархии
+        [[nodiscard]] const Method *GetMethod(symbols::Symbol name) const;
 
         // Возвращает имя класса
         [[nodiscard]] const std::string &GetName() const;
 
+        // Возвращает родительский класс либо nullptr
+        [[nodiscard]] const Class *GetParent() const{
+            return parent_;
+        }
+
+        // Возвращает собственные методы класса, без унаследованных
+        [[nodiscard]] const std::vector<Method> &GetMethods() const{
+            return methods_;
+        }
+
+        // Возвращает true, если класс объявляет поля
+        [[nodiscard]] bool DeclaresSlots() const{
+            return declares_slots_;
+        }
+
+        // Возвращает поля, объявленные самим классом, без унаследованных
+        [[nodiscard]] const std::vector<symbols::Symbol> &GetSlots() const{
+            return slots_;
+        }
+
+        // Форма, с которой начинают экземпляры класса: поля, объявленные классом и его предками
+        [[nodiscard]] const Shape &GetLayout() const{
+            return *layout_;
+        }
+
+        // Возвращает true, если экземпляр не может получить поля сверх GetLayout()
+        [[nodiscard]] bool IsLayoutFixed() const{
+            return layout_fixed_;
+        }
+
+        // Возвращает номер класса, уникальный среди всех классов, созданных программой.
+        // В отличие от адреса, номер не достаётся новому классу после удаления старого
+        [[nodiscard]] uint64_t GetId() const{
+            return id_;
+        }
+
         // Выводит в os строку "Class <имя класса>", например "Class cat"
         void Print(std::ostream &os, Context &context) override;
 
     private:
-        struct Cmp{
-            bool operator()(const runtime::Method& lhs,const runtime::Method& rhs)const {
-                return lhs.name < rhs.name;
-            }
-        };
-
+        uint64_t id_;
         std::string name_;
         std::vector<Method> methods_;
         const Class* parent_;
+        // Все методы класса, включая унаследованные и не переопределённые, по именам.
+        // Строится при создании класса, поэтому родитель не должен меняться после создания наследника
+        std::unordered_map<symbols::Symbol, const Method *> method_table_;
+        std::vector<symbols::Symbol> slots_;
+        bool declares_slots_ = false;
+        const Shape *layout_;
+        bool layout_fixed_ = false;
+    };
+
+    /*
+     * Кеш поиска метода в месте вызова. Запоминает найденные методы для первых CAPACITY классов
+     * получателя, встреченных в этом месте, и находит их линейным сравнением номеров классов.
+     * Для остальных классов место вызова считается мегаморфным и метод каждый раз ищется
+     * в таблице класса. Найденные методы действительны, пока жив их класс
+     */
+    class MethodCache{
+    public:
+        static constexpr size_t CAPACITY = 4;
+
+        explicit MethodCache(symbols::Symbol name)
+            : name_(name){
+        }
+
+        // Возвращает метод класса cls, принимающий argument_count параметров, либо nullptr
+        [[nodiscard]] const Method *Find(const Class &cls, size_t argument_count){
+            const uint64_t id = cls.GetId();
+            const Method *method = nullptr;
+            size_t i = 0;
+            while (i < size_ && entries_[i].class_id != id){
+                ++i;
+            }
+            if (i < size_){
+                method = entries_[i].method;
+            }else{
+                method = cls.GetMethod(name_);
+                if (size_ < CAPACITY){
+                    entries_[size_++] = {id, method};
+                }
+            }
+            return method != nullptr && method->formal_params.size() == argument_count ? method : nullptr;
+        }
+
+        [[nodiscard]] symbols::Symbol GetName() const{
+            return name_;
+        }
+
+        // Число запомненных классов
+        [[nodiscard]] size_t size() const{
+            return size_;
+        }
+
+    private:
+        struct Entry{
+            uint64_t class_id = 0;
+            const Method *method = nullptr;
+        };
+
+        symbols::Symbol name_;
+        std::array<Entry, CAPACITY> entries_{};
+        size_t size_ = 0;
+    };
+
+    class ClassInstance;
+
+    // Аргументы вызова метода, записанные прямо в стек кадров контекста: они станут
+    // слотами 1..n кадра вызываемого метода, слот 0 отведён под self.
+    // Слоты снимаются со стека при разрушении объекта, в том числе после вызова метода
+    class CallArguments{
+    public:
+        CallArguments(Context &context, size_t count);
+        ~CallArguments();
+
+        CallArguments(const CallArguments &) = delete;
+        CallArguments &operator=(const CallArguments &) = delete;
+
+        // Слот аргумента с номером index. Ссылка действительна до следующего изменения
+        // стека кадров, поэтому значение аргумента нужно вычислять до обращения к слоту
+        [[nodiscard]] LocalSlot &operator[](size_t index){
+            return frames_[base_ + index + 1];
+        }
+
+        [[nodiscard]] size_t size() const{
+            return count_;
+        }
+
+    private:
+        friend class MethodFrame;
+
+        FrameStack &frames_;
+        size_t base_;
+        size_t count_;
+    };
+
+    // Кадр вызова метода со слотами локальных переменных. Дополняет слоты аргументов args
+    // слотом self и слотами остальных локальных переменных и на время своей жизни
+    // делает кадр текущим в context
+    class MethodFrame{
+    public:
+        MethodFrame(const Method &method, ClassInstance &self, CallArguments &args, Context &context);
+        ~MethodFrame();
+
+        MethodFrame(const MethodFrame &) = delete;
+        MethodFrame &operator=(const MethodFrame &) = delete;
+
+    private:
+        FrameStack &frames_;
+        size_t previous_frame_;
+    };
+
+    /*
+     * Поля экземпляра класса. Интерфейс повторяет ассоциативный контейнер с именами полей
+     * в качестве ключей, а значения лежат в одном массиве в порядке, заданном формой экземпляра.
+     * Итераторы и ссылки на значения действительны до добавления поля
+     */
+    class InstanceFields{
+        template <typename Value>
+        class BasicIterator{
+        public:
+            using value_type = std::pair<const symbols::Symbol, Value &>;
+
+            // Пара имени и значения, на которую указывает operator->
+            struct Pointer{
+                value_type entry;
+
+                const value_type *operator->() const{
+                    return &entry;
+                }
+            };
+
+            // Указывает на первое поле с номером не меньше slot, которому присвоено значение
+            BasicIterator(const InstanceFields *fields, Value *values, size_t slot)
+                : fields_(fields)
+                , values_(values)
+                , slot_(slot){
+                SkipUnassigned();
+            }
+
+            value_type operator*() const{
+                return {fields_->shape_->GetFieldName(slot_), values_[slot_]};
+            }
+
+            Pointer operator->() const{
+                return {**this};
+            }
+
+            BasicIterator &operator++(){
+                ++slot_;
+                SkipUnassigned();
+                return *this;
+            }
+
+            bool operator==(const BasicIterator &other) const{
+                return values_ == other.values_ && slot_ == other.slot_;
+            }
+
+            bool operator!=(const BasicIterator &other) const{
+                return !(*this == other);
+            }
+
+        private:
+            void SkipUnassigned(){
+                while (slot_ < fields_->values_.size() && !fields_->IsAssigned(slot_)){
+                    ++slot_;
+                }
+            }
+
+            const InstanceFields *fields_;
+            Value *values_;
+            size_t slot_;
+        };
+
+    public:
+        using iterator = BasicIterator<ObjectHolder>;
+        using const_iterator = BasicIterator<const ObjectHolder>;
+
+        InstanceFields() = default;
+        // Создаёт поля формы layout, которым ещё не присвоены значения: до первого присваивания
+        // они считаются отсутствующими. Если fixed равен true, добавление поля,
+        // которого нет в layout, выбрасывает runtime_error
+        InstanceFields(const Shape &layout, bool fixed);
+        InstanceFields(const InstanceFields &other) = default;
+        InstanceFields &operator=(const InstanceFields &other) = default;
+        // Перемещённый объект остаётся без полей
+        InstanceFields(InstanceFields &&other) noexcept;
+        InstanceFields &operator=(InstanceFields &&other) noexcept;
+
+        // Возвращает поле name для присваивания, добавляя его со значением None, если такого поля нет
+        ObjectHolder &operator[](symbols::Symbol name);
+
+        [[nodiscard]] iterator find(symbols::Symbol name);
+        [[nodiscard]] const_iterator find(symbols::Symbol name) const;
+
+        // Возвращают поле name либо выбрасывают std::out_of_range, если такого поля нет
+        [[nodiscard]] ObjectHolder &at(symbols::Symbol name);
+        [[nodiscard]] const ObjectHolder &at(symbols::Symbol name) const;
+
+        [[nodiscard]] size_t count(symbols::Symbol name) const{
+            const size_t slot = shape_->Find(name);
+            return slot != Shape::NO_SLOT && IsAssigned(slot) ? 1 : 0;
+        }
+
+        [[nodiscard]] size_t size() const{
+            return values_.size() - unassigned_count_;
+        }
+
+        [[nodiscard]] bool empty() const{
+            return size() == 0;
+        }
+
+        [[nodiscard]] iterator begin(){
+            return {this, values_.data(), 0};
+        }
+
+        [[nodiscard]] iterator end(){
+            return {this, values_.data(), values_.size()};
+        }
+
+        [[nodiscard]] const_iterator begin() const{
+            return {this, values_.data(), 0};
+        }
+
+        [[nodiscard]] const_iterator end() const{
+            return {this, values_.data(), values_.size()};
+        }
+
+        // Удаляет все поля
+        void clear();
+
+        [[nodiscard]] const Shape &GetShape() const{
+            return *shape_;
+        }
+
+        // Значение поля с номером slot текущей формы
+        [[nodiscard]] const ObjectHolder &GetSlot(size_t slot) const{
+            return values_[slot];
+        }
+
+        // Присвоено ли значение полю с номером slot текущей формы
+        [[nodiscard]] bool IsAssigned(size_t slot) const{
+            return slot >= assigned_.size() || assigned_[slot];
+        }
+
+        // Возвращает поле с номером slot текущей формы для присваивания
+        [[nodiscard]] ObjectHolder &AssignSlot(size_t slot){
+            if (!IsAssigned(slot)){
+                assigned_[slot] = true;
+                --unassigned_count_;
+            }
+            return values_[slot];
+        }
+
+        // Добавляет поле, переводя объект в форму shape, полученную AddField из текущей формы.
+        // Возвращает добавленное поле со значением None
+        ObjectHolder &Append(const Shape &shape);
+
+    private:
+        const Shape *shape_ = &Shape::Empty();
+        std::vector<ObjectHolder> values_;
+        // Отметки присваивания полей, созданных конструктором по форме layout.
+        // Поля, добавленные позже, получают значение сразу
+        std::vector<bool> assigned_;
+        size_t unassigned_count_ = 0;
+        bool fixed_ = false;
+    };
+
+    // Кеш номера поля name в месте обращения к полю. Запоминает номер поля в одной форме
+    // и переход, которым присваивание в этом месте добавляет поле
+    class FieldCache{
+    public:
+        explicit FieldCache(symbols::Symbol name)
+            : name_(name){
+        }
+
+        // Возвращает поле name или nullptr, если такого поля нет или ему не присвоено значение
+        [[nodiscard]] const ObjectHolder *Find(const InstanceFields &fields){
+            const size_t slot = GetSlot(fields.GetShape());
+            return slot != Shape::NO_SLOT && fields.IsAssigned(slot) ? &fields.GetSlot(slot) : nullptr;
+        }
+
+        // Возвращает поле name, добавляя его, если такого поля нет
+        [[nodiscard]] ObjectHolder &Get(InstanceFields &fields){
+            const size_t slot = GetSlot(fields.GetShape());
+            if (slot != Shape::NO_SLOT){
+                return fields.AssignSlot(slot);
+            }
+            if (&fields.GetShape() != transition_from_){
+                transition_from_ = &fields.GetShape();
+                transition_to_ = &transition_from_->AddField(name_);
+            }
+            return fields.Append(*transition_to_);
+        }
+
+        [[nodiscard]] symbols::Symbol GetName() const{
+            return name_;
+        }
+
+    private:
+        size_t GetSlot(const Shape &shape){
+            if (&shape != shape_){
+                shape_ = &shape;
+                slot_ = shape.Find(name_);
+            }
+            return slot_;
+        }
+
+        symbols::Symbol name_;
+        const Shape *shape_ = nullptr;
+        size_t slot_ = Shape::NO_SLOT;
+        const Shape *transition_from_ = nullptr;
+        const Shape *transition_to_ = nullptr;
     };
 
     // Экземпляр класса
     class ClassInstance : public Object{
     public:
         explicit ClassInstance(const Class &cls);
+        // Копия экземпляра не отслеживается сборщиком циклов, пока не будет размещена в куче
+        ClassInstance(const ClassInstance &other);
+        ClassInstance(ClassInstance &&other) noexcept;
+        ~ClassInstance() override;
 
         /*
      * Если у объекта есть метод __str__, выводит в os результат, возвращённый этим методом.
      * В противном случае в os выводится адрес объекта.
      */
         void Print(std::ostream &os, Context &context) override;
+        // Выводит объект так же, но ищет метод __str__ через кеш места вывода str_cache
+        void Print(std::ostream &os, Context &context, MethodCache &str_cache);
         /*
      * Вызывает у объекта метод method, передавая ему actual_args параметров.
      * Параметр context задаёт контекст для выполнения метода.
      * Если ни сам класс, ни его родители не содержат метод method, метод выбрасывает исключение
      * runtime_error
      */
-        ObjectHolder Call(const std::string &method, const std::vector<ObjectHolder> &actual_args,
+        ObjectHolder Call(symbols::Symbol method, const std::vector<ObjectHolder> &actual_args,
                           Context &context);
+        // Вызывает метод method, аргументы которого уже записаны в стек кадров context
+        ObjectHolder Call(symbols::Symbol method, CallArguments &actual_args, Context &context);
+        // Вызывает уже найденный метод класса объекта, например из MethodCache.
+        // Число аргументов должно совпадать с числом параметров метода
+        ObjectHolder Call(const Method &method, CallArguments &actual_args, Context &context);
 
         // Возвращает true, если объект имеет метод method, принимающий argument_count параметров
-        [[nodiscard]] bool HasMethod(const std::string &method, size_t argument_count) const;
+        [[nodiscard]] bool HasMethod(symbols::Symbol method, size_t argument_count) const;
 
-        // Возвращает ссылку на Closure, содержащий поля объекта
-        [[nodiscard]] Closure &Fields();
-        // Возвращает константную ссылку на Closure, содержащую поля объекта
-        [[nodiscard]] const Closure &Fields() const;
+        // Возвращает ссылку на поля объекта
+        [[nodiscard]] InstanceFields &Fields();
+        // Возвращает константную ссылку на поля объекта
+        [[nodiscard]] const InstanceFields &Fields() const;
+
+        // Возвращает класс, экземпляром которого является объект
+        [[nodiscard]] const Class &GetClass() const{
+            return class_;
+        }
 
     private:
+        friend class CycleCollector;
+
+        static constexpr size_t NOT_TRACKED = static_cast<size_t>(-1);
+
         const Class& class_;
-        Closure fields_;
+        InstanceFields fields_;
+        // Сборщик циклов, отслеживающий экземпляр, и номер экземпляра в его списке.
+        // Экземпляр может освобождаться в другом потоке, поэтому сборщик запоминается при отслеживании
+        CycleCollector *collector_ = nullptr;
+        size_t collector_index_ = NOT_TRACKED;
+    };
+
+    /*
+     * Сборщик циклических ссылок между экземплярами классов. Счётчик ссылок не освобождает
+     * экземпляры, которые ссылаются друг на друга через поля, например узлы двусвязного списка.
+     * Сборщик отслеживает все экземпляры, размещённые в куче ObjectHolder::Own, и пробным удалением
+     * находит те, на которые не ссылается ничто, кроме полей таких же недостижимых экземпляров:
+     * из числа ссылок на каждый экземпляр вычитаются ссылки из полей отслеживаемых экземпляров,
+     * экземпляры с оставшимися внешними ссылками и всё, что достижимо из них по полям, живы,
+     * у остальных очищаются поля, после чего они освобождаются счётчиком ссылок.
+     *
+     * Сборка запускается при создании экземпляра, когда с прошлой сборки создано не меньше
+     * порога экземпляров и не меньше, чем пережило прошлую сборку, поэтому её стоимость
+     * пропорциональна числу созданных экземпляров, а память ограничена удвоенным живым набором.
+     * Интерпретатор работает в одном потоке, и у каждого потока свой сборщик. Экземпляр
+     * запоминает отследивший его сборщик и при освобождении в другом потоке удаляется из его списка.
+     * Если сборщик завершается раньше, его экземпляры перестают отслеживаться
+     */
+    class CycleCollector{
+    public:
+        struct Statistics{
+            // Число выполненных сборок
+            size_t collections = 0;
+            // Число экземпляров, освобождённых всеми сборками
+            size_t collected = 0;
+            // Длительность последней, самой долгой и всех сборок
+            std::chrono::nanoseconds last_pause{0};
+            std::chrono::nanoseconds max_pause{0};
+            std::chrono::nanoseconds total_pause{0};
+        };
+
+        static constexpr size_t DEFAULT_THRESHOLD = 10000;
+
+        CycleCollector() = default;
+        CycleCollector(const CycleCollector &) = delete;
+        CycleCollector &operator=(const CycleCollector &) = delete;
+        ~CycleCollector();
+
+        // Сборщик текущего потока
+        static CycleCollector &Instance();
+
+        // Освобождает недостижимые экземпляры и возвращает их число
+        size_t Collect();
+
+        // Задаёт минимальное число созданных экземпляров между сборками. 0 отключает автоматическую сборку
+        void SetThreshold(size_t threshold){
+            threshold_ = threshold;
+        }
+
+        [[nodiscard]] size_t GetThreshold() const{
+            return threshold_;
+        }
+
+        // Число отслеживаемых экземпляров
+        [[nodiscard]] size_t GetTrackedCount() const{
+            const std::lock_guard lock(mutex_);
+            return instances_.size();
+        }
+
+        [[nodiscard]] const Statistics &GetStatistics() const{
+            return statistics_;
+        }
+
+    private:
+        friend class ClassInstance;
+        friend void TrackInstance(ClassInstance &instance);
+
+#ifdef MYTHON_ATOMIC_REFCOUNT
+        // Объекты разделяются между потоками: экземпляр может освобождаться не в потоке сборщика
+        using Mutex = std::mutex;
+#else
+        struct Mutex{
+            void lock(){
+            }
+
+            void unlock(){
+            }
+        };
+#endif
+
+        // Защищает список экземпляров
+        mutable Mutex mutex_;
+        std::vector<ClassInstance *> instances_;
+        size_t threshold_ = DEFAULT_THRESHOLD;
+        size_t created_since_collection_ = 0;
+        size_t survived_last_collection_ = 0;
+        bool collecting_ = false;
+        Statistics statistics_;
+
+        void Track(ClassInstance &instance);
+        void Forget(ClassInstance &instance);
+        // Возвращает экземпляр, которым владеет value, если этот сборщик его отслеживает
+        [[nodiscard]] ClassInstance *GetTracked(const ObjectHolder &value) const;
     };
 
     /*
@@ -220,6 +1028,28 @@ namespace runtime
     // Возвращает значение, противоположное Less(lhs, rhs, context)
     bool GreaterOrEqual(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context);
 
+    // Функции сравнения одного места сравнения в программе. Результаты совпадают с одноимёнными
+    // свободными функциями, но методы __eq__ и __lt__ ищутся через кеши этого места
+    class ComparisonCaches{
+    public:
+        ComparisonCaches();
+
+        bool Equal(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context);
+        bool Less(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context);
+        bool NotEqual(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context);
+        bool Greater(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context);
+        bool LessOrEqual(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context);
+        bool GreaterOrEqual(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context);
+
+    private:
+        MethodCache equal_;
+        MethodCache less_;
+    };
+
+    // Выводит value в os, а None — как строку "None". Метод __str__ экземпляра класса
+    // ищется через кеш места вывода str_cache
+    void PrintValue(const ObjectHolder &value, std::ostream &os, Context &context, MethodCache &str_cache);
+
     // Контекст-заглушка, применяется в тестах.
     // В этом контексте весь вывод перенаправляется в строковый поток вывода output
     struct DummyContext : Context
@@ -2,6 +2,7 @@
 #include "test_runner_p.h"
 
 #include <functional>
+#include <thread>
 
 using namespace std;
 
@@ -22,13 +23,15 @@ namespace runtime
             }
 
             Logger(const Logger &rhs)
-                : id_(rhs.id_) //
+                : Object(rhs)
+                , id_(rhs.id_) //
             {
                 ++instance_count;
             }
 
             Logger(Logger &&rhs) noexcept
-                : id_(rhs.id_) //
+                : Object(rhs)
+                , id_(rhs.id_) //
             {
                 ++instance_count;
             }
@@ -234,6 +237,110 @@ namespace runtime
             ASSERT_EQUAL(context.output.str(), "312"sv);
         }
 
+        void TestSharedOwnership()
+        {
+            // Объект живёт, пока существует хотя бы одна владеющая им копия ObjectHolder
+            ASSERT_EQUAL(Logger::instance_count, 0);
+            {
+                ObjectHolder copy;
+                {
+                    auto oh = ObjectHolder::Own(Logger(7));
+                    copy = oh;
+                    ObjectHolder other = oh;
+                    other = ObjectHolder::None();
+                    ASSERT(copy.Get() == oh.Get());
+                }
+                ASSERT_EQUAL(Logger::instance_count, 1);
+                ASSERT_EQUAL(copy.TryAs<Logger>()->GetId(), 7);
+
+                // Невладеющий ObjectHolder не продлевает жизнь объекта
+                auto shared = ObjectHolder::Share(*copy);
+                copy = ObjectHolder::None();
+                ASSERT_EQUAL(Logger::instance_count, 0);
+            }
+            ASSERT_EQUAL(Logger::instance_count, 0);
+        }
+
+        void TestCycleCollector()
+        {
+            CycleCollector &collector = CycleCollector::Instance();
+            const size_t threshold = collector.GetThreshold();
+            collector.SetThreshold(0);
+            collector.Collect();
+            const size_t tracked = collector.GetTrackedCount();
+
+            Class cls{"Node"s, {}, nullptr};
+            ASSERT_EQUAL(Logger::instance_count, 0);
+            {
+                // Два экземпляра ссылаются друг на друга, один из них — на Logger
+                auto first = ObjectHolder::Own(ClassInstance{cls});
+                auto second = ObjectHolder::Own(ClassInstance{cls});
+                first.TryAs<ClassInstance>()->Fields()["next"s] = second;
+                first.TryAs<ClassInstance>()->Fields()["payload"s] = ObjectHolder::Own(Logger(1));
+                second.TryAs<ClassInstance>()->Fields()["prev"s] = first;
+
+                // Третий экземпляр ссылается сам на себя, но на него есть внешняя ссылка
+                auto alive = ObjectHolder::Own(ClassInstance{cls});
+                alive.TryAs<ClassInstance>()->Fields()["self"s] = alive;
+                ASSERT_EQUAL(collector.GetTrackedCount(), tracked + 3);
+
+                ASSERT_EQUAL(collector.Collect(), 0U);
+                first = ObjectHolder::None();
+                second = ObjectHolder::None();
+                ASSERT_EQUAL(Logger::instance_count, 1);
+
+                const size_t collections = collector.GetStatistics().collections;
+                ASSERT_EQUAL(collector.Collect(), 2U);
+                ASSERT_EQUAL(Logger::instance_count, 0);
+                ASSERT_EQUAL(collector.GetTrackedCount(), tracked + 1);
+                ASSERT_EQUAL(collector.GetStatistics().collections, collections + 1);
+                ASSERT(collector.GetStatistics().max_pause >= collector.GetStatistics().last_pause);
+                ASSERT(alive.TryAs<ClassInstance>()->Fields().count("self"s));
+
+                alive = ObjectHolder::None();
+            }
+
+            // Сборка запускается сама, когда создано достаточно экземпляров
+            collector.SetThreshold(10);
+            const size_t collected = collector.GetStatistics().collected;
+            for (int i = 0; i < 100; ++i){
+                auto node = ObjectHolder::Own(ClassInstance{cls});
+                node.TryAs<ClassInstance>()->Fields()["self"s] = node;
+            }
+            ASSERT(collector.GetTrackedCount() <= tracked + 20);
+            ASSERT(collector.GetStatistics().collected >= collected + 90);
+
+            collector.SetThreshold(threshold);
+            collector.Collect();
+            ASSERT_EQUAL(collector.GetTrackedCount(), tracked);
+
+            // Экземпляр, освобождённый в другом потоке, удаляется из списка отследившего его сборщика
+            {
+                auto shared = ObjectHolder::Own(ClassInstance{cls});
+                auto other = ObjectHolder::Own(ClassInstance{cls});
+                size_t tracked_by_thread = 1;
+                std::thread([moved = std::move(shared), &tracked_by_thread]() mutable {
+                    moved = ObjectHolder::None();
+                    tracked_by_thread = CycleCollector::Instance().GetTrackedCount();
+                }).join();
+                ASSERT_EQUAL(tracked_by_thread, 0U);
+                ASSERT_EQUAL(collector.GetTrackedCount(), tracked + 1);
+                ASSERT(other.TryAs<ClassInstance>() != nullptr);
+            }
+            ASSERT_EQUAL(collector.GetTrackedCount(), tracked);
+
+            // Экземпляр, переживший сборщик своего потока, освобождается без обращения к нему
+            ObjectHolder orphan;
+            size_t tracked_by_thread = 0;
+            std::thread([&orphan, &cls, &tracked_by_thread]{
+                orphan = ObjectHolder::Own(ClassInstance{cls});
+                tracked_by_thread = CycleCollector::Instance().GetTrackedCount();
+            }).join();
+            ASSERT_EQUAL(tracked_by_thread, 1U);
+            orphan = ObjectHolder::None();
+            ASSERT_EQUAL(collector.GetTrackedCount(), tracked);
+        }
+
         void TestMove()
         {
             {
@@ -266,6 +373,62 @@ namespace runtime
             ASSERT(!oh.Get());
         }
 
+        void TestImmediateValues()
+        {
+            // Числа и логические значения хранятся внутри ObjectHolder, а не в куче
+            auto number = ObjectHolder::Own(Number{42});
+            const auto *begin = reinterpret_cast<const char *>(&number);
+            const auto *stored = reinterpret_cast<const char *>(number.Get());
+            ASSERT(stored >= begin && stored < begin + sizeof(ObjectHolder));
+            ASSERT_EQUAL(number.TryAs<Number>()->GetValue(), 42);
+            ASSERT(!number.TryAs<Bool>());
+            ASSERT(!number.TryAs<String>());
+
+            // Копии независимы, но равны
+            ObjectHolder copy = number;
+            ASSERT(copy.Get() != number.Get());
+            DummyContext context;
+            ASSERT(Equal(copy, number, context));
+            ASSERT(Less(number, ObjectHolder::Own(Number{43}), context));
+
+            auto flag = ObjectHolder::Own(Bool{true});
+            ASSERT(flag.TryAs<Bool>()->GetValue());
+            ASSERT(!flag.TryAs<Number>());
+            ASSERT(IsTrue(flag));
+
+            ObjectHolder moved = std::move(flag);
+            ASSERT(moved.TryAs<Bool>());
+            ASSERT(!flag); // NOLINT
+        }
+
+        void TestObjectTypes()
+        {
+            ASSERT(ObjectHolder::None().GetType() == ObjectType::None);
+            ASSERT(ObjectHolder::Own(Number{1}).GetType() == ObjectType::Number);
+            ASSERT(ObjectHolder::Own(String{"s"s}).GetType() == ObjectType::String);
+            ASSERT(ObjectHolder::Own(Bool{false}).GetType() == ObjectType::Bool);
+
+            Class cls{"Test"s, {}, nullptr};
+            auto cls_holder = ObjectHolder::Share(cls);
+            ASSERT(cls_holder.GetType() == ObjectType::Class);
+            ASSERT(cls_holder.TryAs<Class>() == &cls);
+            ASSERT(!cls_holder.TryAs<ClassInstance>());
+
+            auto instance = ObjectHolder::Own(ClassInstance{cls});
+            ASSERT(instance.GetType() == ObjectType::ClassInstance);
+            ASSERT(&instance.TryAs<ClassInstance>()->GetClass() == &cls);
+            ASSERT(!instance.TryAs<Class>());
+
+            // Объекты, не перечисленные в ObjectType, по-прежнему приводятся через RTTI
+            Logger logger;
+            auto other = ObjectHolder::Share(logger);
+            ASSERT(other.GetType() == ObjectType::Other);
+            ASSERT(other.TryAs<Logger>() == &logger);
+            ASSERT(!other.TryAs<Number>());
+
+            ASSERT(TypePair(ObjectType::Number, ObjectType::String) != TypePair(ObjectType::String, ObjectType::Number));
+        }
+
         void TestIsTrue()
         {
             {
@@ -534,6 +697,163 @@ namespace runtime
             ASSERT_EQUAL(out.str(), "Class Test"s);
         }
 
+        void TestMethodTable()
+        {
+            auto make_methods = [](std::initializer_list<std::string> names){
+                vector<Method> methods;
+                for (const auto &name : names){
+                    methods.push_back({name, {}, make_unique<TestMethodBody>(nullptr)});
+                }
+                return methods;
+            };
+
+            Class base{"Base"s, make_methods({"f"s, "g"s}), nullptr};
+            Class middle{"Middle"s, make_methods({"g"s, "h"s}), &base};
+            Class derived{"Derived"s, make_methods({"h"s}), &middle};
+
+            // Таблица наследника содержит методы всех предков, переопределённые берутся у ближайшего
+            ASSERT(derived.GetMethod("f"s) == &base.GetMethods()[0]);
+            ASSERT(derived.GetMethod("g"s) == &middle.GetMethods()[0]);
+            ASSERT(derived.GetMethod("h"s) == &derived.GetMethods()[0]);
+            ASSERT(middle.GetMethod("h"s) == &middle.GetMethods()[1]);
+            ASSERT(base.GetMethod("h"s) == nullptr);
+            ASSERT(derived.GetMethod("missing"s) == nullptr);
+
+            // Таблица остаётся действительной после перемещения класса
+            Class moved = std::move(derived);
+            ASSERT(moved.GetMethod("h"s) == &moved.GetMethods()[0]);
+
+            ASSERT_THROWS((Class{"Overloaded"s, make_methods({"f"s, "f"s}), nullptr}), std::runtime_error);
+        }
+
+        void TestMethodCache()
+        {
+            auto make_methods = [](std::initializer_list<std::string> names){
+                vector<Method> methods;
+                for (const auto &name : names){
+                    methods.push_back({name, {}, make_unique<TestMethodBody>(nullptr)});
+                }
+                return methods;
+            };
+
+            MethodCache cache("f"s);
+            Class base{"Base"s, make_methods({"f"s}), nullptr};
+            Class other{"Other"s, make_methods({"g"s}), nullptr};
+            ASSERT(base.GetId() != other.GetId());
+
+            ASSERT(cache.Find(base, 0) == &base.GetMethods()[0]);
+            ASSERT(cache.Find(base, 0) == &base.GetMethods()[0]);
+            ASSERT(cache.Find(base, 1) == nullptr);
+            ASSERT(cache.Find(other, 0) == nullptr);
+            ASSERT_EQUAL(cache.size(), 2U);
+
+            // Сверх CAPACITY классов методы ищутся без запоминания
+            vector<unique_ptr<Class>> derived;
+            for (size_t i = 0; i < MethodCache::CAPACITY + 2; ++i){
+                derived.push_back(make_unique<Class>("Derived"s + to_string(i), make_methods({"f"s}), &base));
+                ASSERT(cache.Find(*derived.back(), 0) == &derived.back()->GetMethods()[0]);
+            }
+            ASSERT_EQUAL(cache.size(), MethodCache::CAPACITY);
+            for (const auto &cls : derived){
+                ASSERT(cache.Find(*cls, 0) == &cls->GetMethods()[0]);
+            }
+
+            // Класс, созданный на месте удалённого, не получает его закешированный метод
+            MethodCache fresh("f"s);
+            auto removed = make_unique<Class>("Removed"s, make_methods({"f"s}), nullptr);
+            ASSERT(fresh.Find(*removed, 0) != nullptr);
+            removed.reset();
+            auto replacement = make_unique<Class>("Replacement"s, make_methods({"g"s}), nullptr);
+            ASSERT(fresh.Find(*replacement, 0) == nullptr);
+
+            // Место вывода запоминает __str__ в своём кеше, даже если до него выводились
+            // объекты большего числа классов, чем вмещает кеш
+            DummyContext context;
+            auto str_body = [](Closure &, Context &){
+                return ObjectHolder::Own(String{"str"s});
+            };
+            vector<unique_ptr<Class>> printable;
+            for (size_t i = 0; i < MethodCache::CAPACITY + 1; ++i){
+                vector<Method> methods;
+                methods.push_back({"__str__"s, {}, make_unique<TestMethodBody>(str_body)});
+                printable.push_back(make_unique<Class>("Printable"s + to_string(i), std::move(methods), nullptr));
+                ClassInstance instance{*printable.back()};
+                instance.Print(context.output, context);
+            }
+            MethodCache str_cache("__str__"s);
+            ClassInstance last{*printable.back()};
+            PrintValue(ObjectHolder::Share(last), context.output, context, str_cache);
+            PrintValue(ObjectHolder::None(), context.output, context, str_cache);
+            ASSERT_EQUAL(context.output.str(), "strstrstrstrstrstrNone"s);
+            ASSERT_EQUAL(str_cache.size(), 1U);
+        }
+
+        void TestInstanceShapes()
+        {
+            Class cls{"Point"s, {}, nullptr};
+            ClassInstance first{cls};
+            ClassInstance second{cls};
+            ClassInstance reversed{cls};
+
+            ASSERT_EQUAL(&first.Fields().GetShape(), &Shape::Empty());
+            first.Fields()["x"s] = ObjectHolder::Own(Number{1});
+            first.Fields()["y"s] = ObjectHolder::Own(Number{2});
+            second.Fields()["x"s] = ObjectHolder::Own(Number{3});
+            second.Fields()["y"s] = ObjectHolder::Own(Number{4});
+            reversed.Fields()["y"s] = ObjectHolder::Own(Number{5});
+            reversed.Fields()["x"s] = ObjectHolder::Own(Number{6});
+
+            // Экземпляры с одинаковым порядком добавления полей разделяют форму
+            ASSERT_EQUAL(&first.Fields().GetShape(), &second.Fields().GetShape());
+            ASSERT(&first.Fields().GetShape() != &reversed.Fields().GetShape());
+            ASSERT_EQUAL(first.Fields().GetShape().Find("y"s), 1U);
+            ASSERT_EQUAL(reversed.Fields().GetShape().Find("y"s), 0U);
+            ASSERT_EQUAL(second.Fields().at("y"s).TryAs<Number>()->GetValue(), 4);
+            ASSERT_EQUAL(reversed.Fields().at("x"s).TryAs<Number>()->GetValue(), 6);
+            ASSERT_EQUAL(first.Fields().count("z"s), 0U);
+            ASSERT(first.Fields().find("z"s) == first.Fields().end());
+            ASSERT_THROWS(static_cast<void>(first.Fields().at("z"s)), std::out_of_range);
+
+            // Перебор идёт в порядке добавления полей
+            vector<string> names;
+            for (const auto &[name, value] : reversed.Fields()){
+                names.push_back(name.GetName());
+                ASSERT(value.TryAs<Number>() != nullptr);
+            }
+            ASSERT_EQUAL(names, (vector<string>{"y"s, "x"s}));
+
+            // Кеш поля находит поле по запомненной форме и добавляет поле по запомненному переходу
+            FieldCache z_cache("z"s);
+            ASSERT(z_cache.Find(first.Fields()) == nullptr);
+            z_cache.Get(first.Fields()) = ObjectHolder::Own(Number{7});
+            z_cache.Get(second.Fields()) = ObjectHolder::Own(Number{8});
+            ASSERT_EQUAL(&first.Fields().GetShape(), &second.Fields().GetShape());
+            ASSERT_EQUAL(z_cache.Find(second.Fields())->TryAs<Number>()->GetValue(), 8);
+            FieldCache x_cache("x"s);
+            ASSERT_EQUAL(x_cache.Find(reversed.Fields())->TryAs<Number>()->GetValue(), 6);
+            ASSERT_EQUAL(x_cache.Find(first.Fields())->TryAs<Number>()->GetValue(), 1);
+
+            // Поля большого объекта ищутся по хеш-таблице формы
+            ClassInstance wide{cls};
+            for (int i = 0; i < 20; ++i){
+                wide.Fields()["f"s + to_string(i)] = ObjectHolder::Own(Number{i});
+            }
+            for (int i = 0; i < 20; ++i){
+                ASSERT_EQUAL(wide.Fields().at("f"s + to_string(i)).TryAs<Number>()->GetValue(), i);
+            }
+
+            // Перемещённые и очищенные поля возвращаются к пустой форме
+            ClassInstance moved = std::move(wide);
+            ASSERT_EQUAL(moved.Fields().size(), 20U);
+            ASSERT(wide.Fields().empty());
+            ASSERT_EQUAL(&wide.Fields().GetShape(), &Shape::Empty());
+            ClassInstance copy = first;
+            ASSERT_EQUAL(&copy.Fields().GetShape(), &first.Fields().GetShape());
+            copy.Fields().clear();
+            ASSERT(copy.Fields().empty() && copy.Fields().count("x"s) == 0);
+            ASSERT_EQUAL(first.Fields().size(), 3U);
+        }
+
         void TestClassInstance()
         {
             vector<Method> methods;
@@ -572,15 +892,22 @@ namespace runtime
         RUN_TEST(tr, runtime::TestIsTrue);
         RUN_TEST(tr, runtime::TestComparison);
         RUN_TEST(tr, runtime::TestClass);
+        RUN_TEST(tr, runtime::TestMethodTable);
+        RUN_TEST(tr, runtime::TestMethodCache);
         RUN_TEST(tr, runtime::TestClassInstance);
+        RUN_TEST(tr, runtime::TestInstanceShapes);
     }
 
     void RunObjectHolderTests(TestRunner &tr)
     {
         RUN_TEST(tr, runtime::TestNonowning);
         RUN_TEST(tr, runtime::TestOwning);
+        RUN_TEST(tr, runtime::TestSharedOwnership);
         RUN_TEST(tr, runtime::TestMove);
+        RUN_TEST(tr, runtime::TestCycleCollector);
         RUN_TEST(tr, runtime::TestNullptr);
+        RUN_TEST(tr, runtime::TestImmediateValues);
+        RUN_TEST(tr, runtime::TestObjectTypes);
     }
 
 } // namespace runtime
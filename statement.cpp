@@ -13,32 +13,62 @@ using runtime::Context;
 using runtime::ObjectHolder;
 
 namespace {
-const string ADD_METHOD = "__add__"s;
-const string INIT_METHOD = "__init__"s;
+const symbols::Symbol ADD_METHOD = "__add__"sv;
+const symbols::Symbol STR_METHOD = "__str__"sv;
+const symbols::Symbol INIT_METHOD = "__init__"sv;
+
+// Переносит инструкции в список, размещённый в арене текущей области
+StatementList ToStatementList(std::vector<std::unique_ptr<Statement>> statements) {
+    return StatementList(std::make_move_iterator(statements.begin()),
+                         std::make_move_iterator(statements.end()), runtime::CurrentResource());
+}
 }  // namespace
 
 ObjectHolder Assignment::Execute(Closure& closure, Context& context) {
+    if(slot_ != NO_SLOT){
+        ObjectHolder value = expression_->Execute(closure,context);
+        return *(context.GetLocals()[slot_] = std::move(value));
+    }
 
     const auto it = closure.insert_or_assign(var_name_,expression_->Execute(closure,context));
     return it.first->second;
 }
 
-Assignment::Assignment(std::string var, std::unique_ptr<Statement> rv)
+Assignment::Assignment(symbols::Symbol var, std::unique_ptr<Statement> rv)
     :var_name_(std::move(var))
     ,expression_(std::move(rv)){
 
 }
 
-VariableValue::VariableValue(const std::string& var_name) {
+VariableValue::VariableValue(symbols::Symbol var_name) {
     dotted_ids_.push_back(var_name);
 }
 
-VariableValue::VariableValue(std::vector<std::string> dotted_ids)
-    :dotted_ids_(std::move(dotted_ids)) {
+VariableValue::VariableValue(std::vector<symbols::Symbol> dotted_ids)
+    :dotted_ids_(dotted_ids.begin(), dotted_ids.end(), runtime::CurrentResource()) {
+    CreateFieldCaches();
+}
+
+VariableValue::VariableValue(const std::vector<std::string>& dotted_ids)
+    :dotted_ids_(dotted_ids.begin(), dotted_ids.end(), runtime::CurrentResource()) {
+    CreateFieldCaches();
 }
 
-ObjectHolder VariableValue::Execute(Closure& closure, Context& /*context*/) {
+void VariableValue::CreateFieldCaches() {
+    for (size_t i = 1; i < dotted_ids_.size(); ++i){
+        field_caches_.emplace_back(dotted_ids_[i]);
+    }
+}
+
+ObjectHolder VariableValue::Execute(Closure& closure, Context& context) {
+    const runtime::LocalSlot* local = slot_ != NO_SLOT ? &context.GetLocals()[slot_] : nullptr;
     if(dotted_ids_.size() == 1){
+        if(local){
+            if(!*local){
+                throw std::runtime_error("ERROR: Unknown name"s);
+            }
+            return **local;
+        }
         const auto it = closure.find(dotted_ids_[0]);
         if(it != closure.end()){
             return  it->second;
@@ -47,18 +77,21 @@ ObjectHolder VariableValue::Execute(Closure& closure, Context& /*context*/) {
         }
     }
 
-    ObjectHolder obj = closure.at(dotted_ids_[0]);
+    if(local && !*local){
+        throw std::out_of_range("ERROR: Unknown name"s);
+    }
+    ObjectHolder obj = local ? **local : closure.at(dotted_ids_[0]);
     auto* class_ptr = obj.TryAs<runtime::ClassInstance>();
     if(!class_ptr){
         throw std::runtime_error("ERROR:The object is not a class"s);
     }
     for (size_t i = 1; i + 1 < dotted_ids_.size(); ++i){
 
-        const auto item = class_ptr->Fields().find(dotted_ids_[i]);
+        const ObjectHolder* item = field_caches_[i - 1].Find(class_ptr->Fields());
 
-        if(item == class_ptr->Fields().end())
+        if(!item)
             throw std::runtime_error("ERROR:Accessing a non-existent field"s);
-        obj = item->second;
+        obj = ObjectHolder(*item);
 
         class_ptr = obj.TryAs<runtime::ClassInstance>();
         if(!class_ptr){
@@ -66,23 +99,24 @@ ObjectHolder VariableValue::Execute(Closure& closure, Context& /*context*/) {
         }
 
     }
-    const auto& fields = obj.TryAs<runtime::ClassInstance>()->Fields();
-    if (const auto it =fields.find(dotted_ids_.back());it!=fields.end()){
-        return it->second;
+    if (const ObjectHolder* field = field_caches_.back().Find(class_ptr->Fields())){
+        return *field;
     }
     throw std::runtime_error("ERROR: Unknown name"s);
 }
 
-unique_ptr<Print> Print::Variable(const std::string& name) {
+unique_ptr<Print> Print::Variable(symbols::Symbol name) {
     return std::make_unique<Print>(std::make_unique<VariableValue>(name));
 }
 
-Print::Print(unique_ptr<Statement> argument){
+Print::Print(unique_ptr<Statement> argument)
+    :str_cache_(STR_METHOD){
     args_.push_back(std::move(argument));
 }
 
 Print::Print(vector<unique_ptr<Statement>> args)
-    :args_(std::move(args)) {
+    :args_(ToStatementList(std::move(args)))
+    ,str_cache_(STR_METHOD) {
 }
 
 ObjectHolder Print::Execute(Closure& closure, Context& context) {
@@ -92,11 +126,7 @@ ObjectHolder Print::Execute(Closure& closure, Context& context) {
         if(!first){
             context.GetOutputStream() << ' ';
         }
-        if(value){
-            value->Print(context.GetOutputStream(),context);
-        }else{
-            context.GetOutputStream() << "None";
-        }
+        runtime::PrintValue(value, context.GetOutputStream(), context, str_cache_);
         if(args_.size() == 1)
             break;
         first = false;
@@ -105,69 +135,97 @@ ObjectHolder Print::Execute(Closure& closure, Context& context) {
     return ObjectHolder::None();
 }
 
-MethodCall::MethodCall(std::unique_ptr<Statement> object, std::string method,
+MethodCall::MethodCall(std::unique_ptr<Statement> object, symbols::Symbol method,
                        std::vector<std::unique_ptr<Statement>> args)
     :object_(std::move(object))
     ,method_(std::move(method))
-    ,args_(std::move(args)) {
+    ,args_(ToStatementList(std::move(args)))
+    ,cache_(method_) {
 }
 
 ObjectHolder MethodCall::Execute(Closure& closure, Context& context) {
-    std::vector<runtime::ObjectHolder> object_args;
-    for (const auto &arg : args_){
-        object_args.push_back(arg->Execute(closure, context));
+    runtime::CallArguments object_args(context, args_.size());
+    for (size_t i = 0; i < args_.size(); ++i){
+        ObjectHolder value = args_[i]->Execute(closure, context);
+        object_args[i] = std::move(value);
     }
 
-    auto* cls = object_->Execute(closure, context).TryAs<runtime::ClassInstance>();
+    const ObjectHolder object = object_->Execute(closure, context);
+    auto* cls = object.TryAs<runtime::ClassInstance>();
     if(!cls)
         throw std::runtime_error("ERROR:the object is not a class");
-    return cls->Call(method_, object_args, context);
+    const runtime::Method* method = cache_.Find(cls->GetClass(), object_args.size());
+    if(!method)
+        throw std::runtime_error("ERROR:Такого метода не существует");
+    return cls->Call(*method, object_args, context);
+}
+
+Stringify::Stringify(unique_ptr<Statement> argument)
+    :UnaryOperation(std::move(argument))
+    ,str_cache_(STR_METHOD) {
 }
 
 ObjectHolder Stringify::Execute(Closure& closure, Context& context) {
-    const auto arg =GetArg()->Execute(closure,context);
-    //std::ostringstream out;
-    if(const auto ptr = arg.TryAs<runtime::Number>()){
-        std::ostringstream out;
-        ptr->Print(out,context);
-        return ObjectHolder::Own(runtime::String(out.str()));
-    }else if(const auto ptr = arg.TryAs<runtime::String>()){
-        std::ostringstream out;
-        ptr->Print(out,context);
-        return ObjectHolder::Own(runtime::String(out.str()));
-    }else if(const auto ptr = arg.TryAs<runtime::Bool>()){
-        std::ostringstream out;
-        ptr->Print(out,context);
-        return ObjectHolder::Own(runtime::String(out.str()));
-    }else if(const auto ptr = arg.TryAs<runtime::ClassInstance>()){
-        std::ostringstream out;
-        ptr->Print(out,context);
-        return ObjectHolder::Own(runtime::String(out.str()));
-    }else{
-        return ObjectHolder::Own(runtime::String("None"));
+    return Apply(GetArg()->Execute(closure,context),context,str_cache_);
+}
+
+ObjectHolder Stringify::Apply(const ObjectHolder& arg, Context& context, runtime::MethodCache& str_cache) {
+    switch(arg.GetType()){
+        case runtime::ObjectType::Number:
+        case runtime::ObjectType::String:
+        case runtime::ObjectType::Bool:
+        case runtime::ObjectType::ClassInstance:{
+            std::ostringstream out;
+            runtime::PrintValue(arg,out,context,str_cache);
+            return ObjectHolder::Own(runtime::String(out.str()));
+        }
+        default:
+            return ObjectHolder::Own(runtime::String("None"));
     }
 }
 
+Add::Add(unique_ptr<Statement> lhs, unique_ptr<Statement> rhs)
+    :BinaryOperation(std::move(lhs), std::move(rhs))
+    ,add_cache_(ADD_METHOD) {
+}
+
 ObjectHolder Add::Execute(Closure& closure, Context& context) {
-    using namespace runtime;
     const auto lhs_arg = GetLhs()->Execute(closure,context);
     const auto rhs_arg = GetRhs()->Execute(closure,context);
-    if(lhs_arg.TryAs<Number>() && rhs_arg.TryAs<Number>()){
-        return ObjectHolder::Own(Number(lhs_arg.TryAs<Number>()->GetValue() +rhs_arg.TryAs<Number>()->GetValue() ));
-    }else if(lhs_arg.TryAs<String>() && rhs_arg.TryAs<String>()){
-        return ObjectHolder::Own(String(lhs_arg.TryAs<String>()->GetValue() +rhs_arg.TryAs<String>()->GetValue() ));
-    }else if(lhs_arg.TryAs<ClassInstance>()){
-        if(lhs_arg.TryAs<ClassInstance>()->HasMethod(ADD_METHOD,1)){
-            return lhs_arg.TryAs<ClassInstance>()->Call(ADD_METHOD,{rhs_arg},context);
+    return Apply(lhs_arg,rhs_arg,context,add_cache_);
+}
+
+ObjectHolder Add::Apply(const ObjectHolder& lhs_arg, const ObjectHolder& rhs_arg, Context& context,
+                        runtime::MethodCache& add_cache) {
+    using namespace runtime;
+    switch(TypePair(lhs_arg.GetType(), rhs_arg.GetType())){
+        case TypePair(ObjectType::Number, ObjectType::Number):
+            return ObjectHolder::Own(Number(lhs_arg.TryAs<Number>()->GetValue() +rhs_arg.TryAs<Number>()->GetValue() ));
+        case TypePair(ObjectType::String, ObjectType::String):
+            return ObjectHolder::Own(String(lhs_arg.TryAs<String>()->GetValue() +rhs_arg.TryAs<String>()->GetValue() ));
+        default:
+            break;
+    }
+    if(auto* instance = lhs_arg.TryAs<ClassInstance>()){
+        if(const Method* method = add_cache.Find(instance->GetClass(), 1)){
+            CallArguments args(context, 1);
+            args[0] = rhs_arg;
+            return instance->Call(*method, args, context);
         }
     }
     throw std::runtime_error("ERROR:Incorrect operation"s);
 }
 
 ObjectHolder Sub::Execute(Closure& closure, Context& context) {
+    const auto lhs_arg = GetLhs()->Execute(closure,context);
+    const auto rhs_arg = GetRhs()->Execute(closure,context);
+    return Apply(lhs_arg,rhs_arg);
+}
+
+ObjectHolder Sub::Apply(const ObjectHolder& lhs_arg, const ObjectHolder& rhs_arg) {
     using namespace runtime;
-    const auto lhs_arg_ptr = GetLhs()->Execute(closure,context).TryAs<Number>();
-    const auto rhs_arg_ptr = GetRhs()->Execute(closure,context).TryAs<Number>();
+    const auto lhs_arg_ptr = lhs_arg.TryAs<Number>();
+    const auto rhs_arg_ptr = rhs_arg.TryAs<Number>();
 
     if(lhs_arg_ptr && rhs_arg_ptr){
         return ObjectHolder::Own(Number{lhs_arg_ptr->GetValue() - rhs_arg_ptr->GetValue()});
@@ -177,9 +235,15 @@ ObjectHolder Sub::Execute(Closure& closure, Context& context) {
 }
 
 ObjectHolder Mult::Execute(Closure& closure, Context& context) {
+    const auto lhs_arg = GetLhs()->Execute(closure,context);
+    const auto rhs_arg = GetRhs()->Execute(closure,context);
+    return Apply(lhs_arg,rhs_arg);
+}
+
+ObjectHolder Mult::Apply(const ObjectHolder& lhs_arg, const ObjectHolder& rhs_arg) {
     using namespace runtime;
-    const auto lhs_arg_ptr = GetLhs()->Execute(closure,context).TryAs<Number>();
-    const auto rhs_arg_ptr = GetRhs()->Execute(closure,context).TryAs<Number>();
+    const auto lhs_arg_ptr = lhs_arg.TryAs<Number>();
+    const auto rhs_arg_ptr = rhs_arg.TryAs<Number>();
 
     if(lhs_arg_ptr && rhs_arg_ptr){
         return ObjectHolder::Own(Number{lhs_arg_ptr->GetValue() * rhs_arg_ptr->GetValue()});
@@ -189,9 +253,15 @@ ObjectHolder Mult::Execute(Closure& closure, Context& context) {
 }
 
 ObjectHolder Div::Execute(Closure& closure, Context& context) {
+    const auto lhs_arg = GetLhs()->Execute(closure,context);
+    const auto rhs_arg = GetRhs()->Execute(closure,context);
+    return Apply(lhs_arg,rhs_arg);
+}
+
+ObjectHolder Div::Apply(const ObjectHolder& lhs_arg, const ObjectHolder& rhs_arg) {
     using namespace runtime;
-    const auto lhs_arg_ptr = GetLhs()->Execute(closure,context).TryAs<Number>();
-    const auto rhs_arg_ptr = GetRhs()->Execute(closure,context).TryAs<Number>();
+    const auto lhs_arg_ptr = lhs_arg.TryAs<Number>();
+    const auto rhs_arg_ptr = rhs_arg.TryAs<Number>();
 
     if(lhs_arg_ptr && rhs_arg_ptr){
         if(rhs_arg_ptr->GetValue() == 0){
@@ -205,42 +275,58 @@ ObjectHolder Div::Execute(Closure& closure, Context& context) {
 
 ObjectHolder Compound::Execute(Closure& closure, Context& context) {
     for(const auto& arg: instructions_){
-        arg->Execute(closure,context);
+        ObjectHolder result = arg->Execute(closure,context);
+        if(context.IsReturning()){
+            return result;
+        }
     }
     return ObjectHolder::None();
 }
 
+void Compound::Splice(size_t first, size_t count, std::vector<std::unique_ptr<Statement>> statements) {
+    const auto begin = instructions_.begin() + static_cast<std::ptrdiff_t>(first);
+    const auto inserted_at = instructions_.erase(begin, begin + static_cast<std::ptrdiff_t>(count));
+    instructions_.insert(inserted_at, std::make_move_iterator(statements.begin()),
+                         std::make_move_iterator(statements.end()));
+}
+
 ObjectHolder Return::Execute(Closure& closure, Context& context) {
-    throw statement_->Execute(closure,context);
+    ObjectHolder result = statement_->Execute(closure,context);
+    context.BeginReturn();
+    return result;
 }
 
 ClassDefinition::ClassDefinition(ObjectHolder cls)
-    : cls_(std::move(cls)){
+    : cls_(std::move(cls))
+    , name_(cls_.TryAs<runtime::Class>()->GetName()){
 }
 
 ObjectHolder ClassDefinition::Execute(Closure& closure, Context& /*context*/) {
-    closure[cls_.TryAs<runtime::Class>()->GetName()] = cls_;
+    closure[name_] = cls_;
     return cls_;
 }
 
-FieldAssignment::FieldAssignment(VariableValue object, std::string field_name,
+FieldAssignment::FieldAssignment(VariableValue object, symbols::Symbol field_name,
                                  std::unique_ptr<Statement> rv)
     :object_(std::move(object))
     ,field_name_(std::move(field_name))
-    ,expression_(std::move(rv)){
+    ,expression_(std::move(rv))
+    ,field_cache_(field_name_){
 }
 
 ObjectHolder FieldAssignment::Execute(Closure& closure, Context& context) {
 
-    auto* cls = object_.Execute(closure,context).TryAs<runtime::ClassInstance>();
+    const ObjectHolder object = object_.Execute(closure,context);
+    auto* cls = object.TryAs<runtime::ClassInstance>();
 
     if(!cls){
         throw std::runtime_error("ERROR:attempt to access a non-instance class field");
     }
-    auto& fields = cls->Fields();
-
-    fields[field_name_]= expression_->Execute(closure,context);
-    return fields[field_name_];
+    // Вычисление значения может добавить объекту поля, поэтому поле ищется после него
+    ObjectHolder value = expression_->Execute(closure,context);
+    ObjectHolder& field = field_cache_.Get(cls->Fields());
+    field = std::move(value);
+    return field;
 }
 
 IfElse::IfElse(std::unique_ptr<Statement> condition, std::unique_ptr<Statement> if_body,
@@ -251,104 +337,101 @@ IfElse::IfElse(std::unique_ptr<Statement> condition, std::unique_ptr<Statement>
 }
 
 ObjectHolder IfElse::Execute(Closure& closure, Context& context) {
-
-    if(auto inst_Ptr = condition_->Execute(closure,context).TryAs<runtime::Bool>()){
-        return Exec(inst_Ptr,closure,context);
-    }else if (auto inst_Ptr = condition_->Execute(closure,context).TryAs<runtime::Number>()) {
-        return  Exec(inst_Ptr,closure,context);
-    }else if(auto inst_Ptr = condition_->Execute(closure,context).TryAs<runtime::String>()){
-        return  ExecIfString(inst_Ptr,closure,context);
-    }else if(condition_->Execute(closure,context).TryAs<runtime::ClassInstance>()){
+    // Условие вычисляется ровно один раз, даже если оно содержит вызовы методов
+    if(IsConditionTrue(condition_->Execute(closure,context))){
         return if_body_->Execute(closure,context);
-    }else if(!condition_->Execute(closure,context).operator bool()){
-        if(else_body_){
-            return else_body_->Execute(closure,context);
-        }
-        return runtime::ObjectHolder::None();
+    }else if(else_body_){
+        return else_body_->Execute(closure,context);
     }
-    else{
-        throw std::runtime_error("ERROR: value does not bool value");
-    }
-
+    return ObjectHolder::None();
 }
 
 ObjectHolder Or::Execute(Closure& closure, Context& context) {
     ObjectHolder lhs_arg = GetLhs()->Execute(closure, context);
-
-    if(auto inst_Ptr = lhs_arg.TryAs<runtime::Bool>()){
-        return Exec(inst_Ptr,closure,context);
-    }else if (auto inst_Ptr = lhs_arg.TryAs<runtime::Number>()) {
-        return Exec(inst_Ptr,closure,context);
-    }else if(auto inst_Ptr = lhs_arg.TryAs<runtime::String>()){
-        return  ExecIfString(inst_Ptr,closure,context);
-    }else if(lhs_arg.TryAs<runtime::ClassInstance>()){
-        return GetLhs()->Execute(closure,context);
-    }else if(!lhs_arg.operator bool()){
-        return GetRhs()->Execute(closure,context);
-    }else{
-        throw std::runtime_error("ERROR: value does not bool value");
+    if(IsConditionTrue(lhs_arg)){
+        return lhs_arg;
     }
-
+    return GetRhs()->Execute(closure,context);
 }
 
 ObjectHolder And::Execute(Closure& closure, Context& context) {
     ObjectHolder lhs_arg = GetLhs()->Execute(closure, context);
-    if(auto inst_Ptr = lhs_arg.TryAs<runtime::Bool>()){
-        return Exec(inst_Ptr,closure,context);
-    }else if (auto inst_Ptr = lhs_arg.TryAs<runtime::Number>()) {
-        return Exec(inst_Ptr,closure,context);
-    }else if(auto inst_Ptr = lhs_arg.TryAs<runtime::String>()){
-        return  ExecIfString(inst_Ptr,closure,context);
-    }else if(lhs_arg.TryAs<runtime::ClassInstance>()){
-        return GetRhs()->Execute(closure,context);
-    }else if(!lhs_arg.operator bool()){
-        return GetLhs()->Execute(closure,context);
-    }
-    else{
-        throw std::runtime_error("ERROR: value does not bool value");
+    if(!IsConditionTrue(lhs_arg)){
+        return lhs_arg;
     }
-
+    return GetRhs()->Execute(closure,context);
 }
 
 ObjectHolder Not::Execute(Closure& closure, Context& context) {
-    const auto arg = GetArg()->Execute(closure,context);
-    if(auto inst_Ptr = arg.TryAs<runtime::Bool>()){
-        return  ObjectHolder::Own(runtime::Bool{!inst_Ptr->GetValue()});
-    }else if (auto inst_Ptr = arg.TryAs<runtime::Number>()) {
-        return  ObjectHolder::Own(runtime::Bool{!inst_Ptr->GetValue()});
-    }else{
-        throw std::runtime_error("ERROR: value does not bool value");
+    return Apply(GetArg()->Execute(closure,context));
+}
+
+ObjectHolder Not::Apply(const ObjectHolder& arg) {
+    switch(arg.GetType()){
+        case runtime::ObjectType::Bool:
+            return  ObjectHolder::Own(runtime::Bool{!arg.TryAs<runtime::Bool>()->GetValue()});
+        case runtime::ObjectType::Number:
+            return  ObjectHolder::Own(runtime::Bool{!arg.TryAs<runtime::Number>()->GetValue()});
+        default:
+            throw std::runtime_error("ERROR: value does not bool value");
     }
 }
 
 
+Comparison::CachedComparator Comparison::FindCachedComparator(const Comparator& cmp) {
+    using Function = bool (*)(const ObjectHolder&, const ObjectHolder&, Context&);
+    using runtime::ComparisonCaches;
+    static const std::pair<Function, CachedComparator> cached_comparators[] = {
+        {runtime::Equal, &ComparisonCaches::Equal},
+        {runtime::NotEqual, &ComparisonCaches::NotEqual},
+        {runtime::Less, &ComparisonCaches::Less},
+        {runtime::Greater, &ComparisonCaches::Greater},
+        {runtime::LessOrEqual, &ComparisonCaches::LessOrEqual},
+        {runtime::GreaterOrEqual, &ComparisonCaches::GreaterOrEqual},
+    };
+    if(const Function* function = cmp.target<Function>()){
+        for(const auto& [free_function, cached] : cached_comparators){
+            if(*function == free_function)
+                return cached;
+        }
+    }
+    return nullptr;
+}
+
 Comparison::Comparison(Comparator cmp, unique_ptr<Statement> lhs, unique_ptr<Statement> rhs)
     : BinaryOperation(std::move(lhs), std::move(rhs))
-    ,cmp_(std::move(cmp)) {
+    ,cmp_(std::move(cmp))
+    ,cached_cmp_(FindCachedComparator(cmp_)) {
 }
 
 ObjectHolder Comparison::Execute(Closure& closure, Context& context) {
-    return ObjectHolder::Own(runtime::Bool(cmp_(GetLhs()->Execute(closure,context),GetRhs()->Execute(closure,context),context)));
+    const auto lhs_arg = GetLhs()->Execute(closure,context);
+    const auto rhs_arg = GetRhs()->Execute(closure,context);
+    const bool result = cached_cmp_ ? (caches_.*cached_cmp_)(lhs_arg,rhs_arg,context) : cmp_(lhs_arg,rhs_arg,context);
+    return ObjectHolder::Own(runtime::Bool(result));
 }
 
 NewInstance::NewInstance(const runtime::Class& class_, std::vector<std::unique_ptr<Statement>> args)
     :_class_(class_)
-    ,args_(std::move(args)){
+    ,args_(ToStatementList(std::move(args)))
+    ,init_cache_(INIT_METHOD){
 }
 
 NewInstance::NewInstance(const runtime::Class& class_)
-    :_class_(class_) {
+    :_class_(class_)
+    ,init_cache_(INIT_METHOD) {
 }
 
 ObjectHolder NewInstance::Execute(Closure& closure, Context& context){
     ObjectHolder oh = ObjectHolder::Own(runtime::ClassInstance(_class_));
     auto class_inst_ = oh.TryAs<runtime::ClassInstance>();
-    if(class_inst_->HasMethod(INIT_METHOD,args_.size())){
-        std::vector<runtime::ObjectHolder> new_args;
-        for(const auto& arg: args_){
-            new_args.push_back(arg->Execute(closure,context));
+    if(const runtime::Method* init = init_cache_.Find(_class_, args_.size())){
+        runtime::CallArguments new_args(context, args_.size());
+        for(size_t i = 0; i < args_.size(); ++i){
+            ObjectHolder value = args_[i]->Execute(closure,context);
+            new_args[i] = std::move(value);
         }
-        class_inst_->Call(INIT_METHOD,new_args,context);
+        class_inst_->Call(*init,new_args,context);
     }
     return oh;
 }
@@ -358,16 +441,28 @@ MethodBody::MethodBody(std::unique_ptr<Statement>&& body)
 }
 
 ObjectHolder MethodBody::Execute(Closure& closure, Context& context) {
-    ObjectHolder result = ObjectHolder::None();
-
-    try{
-        result = std::move(body_->Execute(closure,context));
-
-    }catch (ObjectHolder& obj) {
-        result = std::move(obj);
-
+    ObjectHolder result = body_->Execute(closure,context);
+    if(!context.EndReturn()){
+        return ObjectHolder::None();
     }
     return result;
 }
 
+bool IsConditionTrue(const ObjectHolder& value) {
+    switch(value.GetType()){
+        case runtime::ObjectType::Bool:
+            return value.TryAs<runtime::Bool>()->GetValue();
+        case runtime::ObjectType::Number:
+            return value.TryAs<runtime::Number>()->GetValue() != 0;
+        case runtime::ObjectType::String:
+            return !value.TryAs<runtime::String>()->GetValue().empty();
+        case runtime::ObjectType::ClassInstance:
+            return true;
+        case runtime::ObjectType::None:
+            return false;
+        default:
+            throw std::runtime_error("ERROR: value does not bool value");
+    }
+}
+
 }  // namespace ast
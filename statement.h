@@ -1,35 +1,50 @@
 #pragma once
 
+#include "arena.h"
 #include "runtime.h"
+#include "statement_visitor.h"
 
 #include <functional>
+#include <limits>
 
 namespace ast {
 
-using Statement = runtime::Executable;
+// Номер слота имени, которое не связано со слотом кадра метода и ищется в closure
+inline constexpr uint32_t NO_SLOT = std::numeric_limits<uint32_t>::max();
 
 // Выражение, возвращающее значение типа T,
-// используется как основа для создания констант
+// используется как основа для создания констант.
+// Значение создаётся один раз при построении дерева, и каждое выполнение возвращает его копию:
+// числа и логические значения копируются внутрь ObjectHolder, строка разделяется без копирования
 template <typename T>
 class ValueStatement : public Statement {
 public:
     explicit ValueStatement(T v)
-        : value_(std::move(v)) {
+        : value_(runtime::ObjectHolder::Own(std::move(v))) {
     }
 
     runtime::ObjectHolder Execute(runtime::Closure& /*closure*/,
                                   runtime::Context& /*context*/) override {
-        return runtime::ObjectHolder::Share(value_);
+        return value_;
+    }
+
+    [[nodiscard]] const T& GetValue() const {
+        return *value_.TryAs<T>();
+    }
+
+    // Возвращает ObjectHolder со значением константы
+    [[nodiscard]] const runtime::ObjectHolder& GetConstant() const {
+        return value_;
+    }
+
+    void Accept(StatementVisitor& visitor) const override {
+        visitor.Visit(*this);
     }
 
 private:
-    T value_;
+    runtime::ObjectHolder value_;
 };
 
-using NumericConst = ValueStatement<runtime::Number>;
-using StringConst = ValueStatement<runtime::String>;
-using BoolConst = ValueStatement<runtime::Bool>;
-
 /*
 Вычисляет значение переменной либо цепочки вызовов полей объектов id1.id2.id3.
 Например, выражение circle.center.x - цепочка вызовов полей объектов в инструкции:
@@ -37,35 +52,101 @@ x = circle.center.x
 */
 class VariableValue : public Statement {
 public:
-    explicit VariableValue(const std::string& var_name);
-    explicit VariableValue(std::vector<std::string> dotted_ids);
+    explicit VariableValue(symbols::Symbol var_name);
+    explicit VariableValue(std::vector<symbols::Symbol> dotted_ids);
+    explicit VariableValue(const std::vector<std::string>& dotted_ids);
 
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    [[nodiscard]] const SymbolList& GetDottedIds() const {
+        return dotted_ids_;
+    }
+
+    // Связывает первое имя цепочки со слотом slot кадра выполняемого метода
+    void BindSlot(uint32_t slot) {
+        slot_ = slot;
+    }
+
+    [[nodiscard]] uint32_t GetSlot() const {
+        return slot_;
+    }
+
+    void Accept(StatementVisitor& visitor) const override {
+        visitor.Visit(*this);
+    }
 private:
-  std::vector<std::string> dotted_ids_;
+  void CreateFieldCaches();
+
+  SymbolList dotted_ids_{runtime::CurrentResource()};
+  uint32_t slot_ = NO_SLOT;
+  // Номера полей цепочки в формах объектов, для каждого имени после первого
+  std::pmr::vector<runtime::FieldCache> field_caches_{runtime::CurrentResource()};
 };
 
 // Присваивает переменной, имя которой задано в параметре var, значение выражения rv
 class Assignment : public Statement {
 public:
-    Assignment(std::string var, std::unique_ptr<Statement> rv);
+    Assignment(symbols::Symbol var, std::unique_ptr<Statement> rv);
 
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    [[nodiscard]] symbols::Symbol GetName() const {
+        return var_name_;
+    }
+
+    [[nodiscard]] const Statement& GetExpression() const {
+        return *expression_;
+    }
+
+    // Связывает переменную со слотом slot кадра выполняемого метода
+    void BindSlot(uint32_t slot) {
+        slot_ = slot;
+    }
+
+    [[nodiscard]] uint32_t GetSlot() const {
+        return slot_;
+    }
+
+    void Accept(StatementVisitor& visitor) const override {
+        visitor.Visit(*this);
+    }
 private:
-    std::string var_name_;
+    symbols::Symbol var_name_;
     std::unique_ptr<Statement> expression_;
+    uint32_t slot_ = NO_SLOT;
 };
 
 // Присваивает полю object.field_name значение выражения rv
 class FieldAssignment : public Statement {
 public:
-    FieldAssignment(VariableValue object, std::string field_name, std::unique_ptr<Statement> rv);
+    FieldAssignment(VariableValue object, symbols::Symbol field_name, std::unique_ptr<Statement> rv);
 
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    [[nodiscard]] const VariableValue& GetObject() const {
+        return object_;
+    }
+
+    [[nodiscard]] VariableValue& GetObject() {
+        return object_;
+    }
+
+    [[nodiscard]] symbols::Symbol GetFieldName() const {
+        return field_name_;
+    }
+
+    [[nodiscard]] const Statement& GetExpression() const {
+        return *expression_;
+    }
+
+    void Accept(StatementVisitor& visitor) const override {
+        visitor.Visit(*this);
+    }
 private:
     VariableValue object_;
-    std::string field_name_;
+    symbols::Symbol field_name_;
     std::unique_ptr<Statement> expression_;
+    runtime::FieldCache field_cache_;
 };
 
 // Значение None
@@ -75,6 +156,10 @@ public:
                                   [[maybe_unused]] runtime::Context& context) override {
         return {};
     }
+
+    void Accept(StatementVisitor& visitor) const override {
+        visitor.Visit(*this);
+    }
 };
 
 // Команда print
@@ -86,26 +171,54 @@ public:
     explicit Print(std::vector<std::unique_ptr<Statement>> args);
 
     // Инициализирует команду print для вывода значения переменной name
-    static std::unique_ptr<Print> Variable(const std::string& name);
+    static std::unique_ptr<Print> Variable(symbols::Symbol name);
 
     // Во время выполнения команды print вывод должен осуществляться в поток, возвращаемый из
     // context.GetOutputStream()
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    [[nodiscard]] const StatementList& GetArgs() const {
+        return args_;
+    }
+
+    void Accept(StatementVisitor& visitor) const override {
+        visitor.Visit(*this);
+    }
 private:
-    std::vector<std::unique_ptr<Statement>> args_;
+    StatementList args_{runtime::CurrentResource()};
+    // Методы __str__ классов, объекты которых выводила эта команда
+    runtime::MethodCache str_cache_;
 };
 
 // Вызывает метод object.method со списком параметров args
 class MethodCall : public Statement {
 public:
-    MethodCall(std::unique_ptr<Statement> object, std::string method,
+    MethodCall(std::unique_ptr<Statement> object, symbols::Symbol method,
                std::vector<std::unique_ptr<Statement>> args);
 
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    [[nodiscard]] const Statement& GetObject() const {
+        return *object_;
+    }
+
+    [[nodiscard]] symbols::Symbol GetMethod() const {
+        return method_;
+    }
+
+    [[nodiscard]] const StatementList& GetArgs() const {
+        return args_;
+    }
+
+    void Accept(StatementVisitor& visitor) const override {
+        visitor.Visit(*this);
+    }
 private:
     std::unique_ptr<Statement> object_;
-    std::string method_;
-    std::vector<std::unique_ptr<Statement>> args_;
+    symbols::Symbol method_;
+    StatementList args_{runtime::CurrentResource()};
+    // Методы method_ классов, объекты которых встречались в этом вызове
+    runtime::MethodCache cache_;
 };
 
 /*
@@ -127,9 +240,22 @@ public:
     NewInstance(const runtime::Class& class_, std::vector<std::unique_ptr<Statement>> args);
     // Возвращает объект, содержащий значение типа ClassInstance
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    [[nodiscard]] const runtime::Class& GetClass() const {
+        return _class_;
+    }
+
+    [[nodiscard]] const StatementList& GetArgs() const {
+        return args_;
+    }
+
+    void Accept(StatementVisitor& visitor) const override {
+        visitor.Visit(*this);
+    }
 private:
     const runtime::Class& _class_;    
-    std::vector<std::unique_ptr<Statement>> args_;
+    StatementList args_{runtime::CurrentResource()};
+    runtime::MethodCache init_cache_;
 };
 
 // Базовый класс для унарных операций
@@ -151,8 +277,18 @@ private:
 // Операция str, возвращающая строковое значение своего аргумента
 class Stringify : public UnaryOperation {
 public:
-    using UnaryOperation::UnaryOperation;
+    explicit Stringify(std::unique_ptr<Statement> argument);
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    // Возвращает строковое значение arg. Метод __str__ ищется через кеш места вызова str_cache
+    static runtime::ObjectHolder Apply(const runtime::ObjectHolder& arg, runtime::Context& context,
+                                       runtime::MethodCache& str_cache);
+
+    void Accept(StatementVisitor& visitor) const override {
+        visitor.Visit(*this);
+    }
+private:
+    runtime::MethodCache str_cache_;
 };
 
 // Родительский класс Бинарная операция с аргументами lhs и rhs
@@ -162,7 +298,7 @@ public:
         :lhs_(std::move(lhs))
         ,rhs_(std::move(rhs)) {        
     }
-protected:
+
     const std::unique_ptr<Statement>& GetLhs() const{
         return lhs_;
     }
@@ -177,7 +313,7 @@ private:
 // Возвращает результат операции + над аргументами lhs и rhs
 class Add : public BinaryOperation {
 public:
-    using BinaryOperation::BinaryOperation;
+    Add(std::unique_ptr<Statement> lhs, std::unique_ptr<Statement> rhs);
 
     // Поддерживается сложение:
     //  число + число
@@ -185,6 +321,17 @@ public:
     //  объект1 + объект2, если у объект1 - пользовательский класс с методом _add__(rhs)
     // В противном случае при вычислении выбрасывается runtime_error
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    // Вычисляет операцию над уже вычисленными значениями lhs и rhs.
+    // Метод __add__ ищется через кеш места вызова add_cache
+    static runtime::ObjectHolder Apply(const runtime::ObjectHolder& lhs, const runtime::ObjectHolder& rhs,
+                                       runtime::Context& context, runtime::MethodCache& add_cache);
+
+    void Accept(StatementVisitor& visitor) const override {
+        visitor.Visit(*this);
+    }
+private:
+    runtime::MethodCache add_cache_;
 };
 
 // Возвращает результат вычитания аргументов lhs и rhs
@@ -196,6 +343,13 @@ public:
     //  число - число
     // Если lhs и rhs - не числа, выбрасывается исключение runtime_error
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    // Вычисляет операцию над уже вычисленными значениями lhs и rhs
+    static runtime::ObjectHolder Apply(const runtime::ObjectHolder& lhs, const runtime::ObjectHolder& rhs);
+
+    void Accept(StatementVisitor& visitor) const override {
+        visitor.Visit(*this);
+    }
 };
 
 // Возвращает результат умножения аргументов lhs и rhs
@@ -207,6 +361,13 @@ public:
     //  число * число
     // Если lhs и rhs - не числа, выбрасывается исключение runtime_error
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    // Вычисляет операцию над уже вычисленными значениями lhs и rhs
+    static runtime::ObjectHolder Apply(const runtime::ObjectHolder& lhs, const runtime::ObjectHolder& rhs);
+
+    void Accept(StatementVisitor& visitor) const override {
+        visitor.Visit(*this);
+    }
 };
 
 // Возвращает результат деления lhs и rhs
@@ -219,6 +380,13 @@ public:
     // Если lhs и rhs - не числа, выбрасывается исключение runtime_error
     // Если rhs равен 0, выбрасывается исключение runtime_error
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    // Вычисляет операцию над уже вычисленными значениями lhs и rhs
+    static runtime::ObjectHolder Apply(const runtime::ObjectHolder& lhs, const runtime::ObjectHolder& rhs);
+
+    void Accept(StatementVisitor& visitor) const override {
+        visitor.Visit(*this);
+    }
 };
 
 // Возвращает результат вычисления логической операции or над lhs и rhs
@@ -228,28 +396,10 @@ public:
     // Значение аргумента rhs вычисляется, только если значение lhs
     // после приведения к Bool равно False
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-private:
-    template<typename ObjPtr>
-    runtime::ObjectHolder Exec(const ObjPtr& obj_ptr,runtime::Closure& closure, runtime::Context& context){
-        if (obj_ptr->GetValue())
-        {
-            return GetLhs()->Execute(closure, context);
-        }
-        return GetRhs()->Execute(closure, context);
-    }
 
-    template<typename StrPtr>
-    runtime::ObjectHolder ExecIfString(const StrPtr& obj_ptr,runtime::Closure& closure, runtime::Context& context){
-        const std::string_view result = obj_ptr->GetValue();
-
-        if (result.size())
-        {
-            return GetLhs()->Execute(closure, context);
-        }
-        return GetRhs()->Execute(closure, context);
+    void Accept(StatementVisitor& visitor) const override {
+        visitor.Visit(*this);
     }
-
-
 };
 
 // Возвращает результат вычисления логической операции and над lhs и rhs
@@ -259,23 +409,9 @@ public:
     // Значение аргумента rhs вычисляется, только если значение lhs
     // после приведения к Bool равно True
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-private:
-    template<typename ObjPtr>
-    runtime::ObjectHolder Exec(const ObjPtr& obj_ptr,runtime::Closure& closure, runtime::Context& context){
-        if (!obj_ptr->GetValue()){
-            return GetLhs()->Execute(closure, context);
-        }
-        return GetRhs()->Execute(closure, context);
-    }
-
-    template<typename StrPtr>
-    runtime::ObjectHolder ExecIfString(const StrPtr& obj_ptr,runtime::Closure& closure, runtime::Context& context){
-        const std::string_view result = obj_ptr->GetValue();
 
-        if (!result.size()){
-            return GetLhs()->Execute(closure, context);
-        }
-        return GetRhs()->Execute(closure, context);
+    void Accept(StatementVisitor& visitor) const override {
+        visitor.Visit(*this);
     }
 };
 
@@ -284,6 +420,13 @@ class Not : public UnaryOperation {
 public:
     using UnaryOperation::UnaryOperation;
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    // Возвращает отрицание arg
+    static runtime::ObjectHolder Apply(const runtime::ObjectHolder& arg);
+
+    void Accept(StatementVisitor& visitor) const override {
+        visitor.Visit(*this);
+    }
 };
 
 // Составная инструкция (например: тело метода, содержимое ветки if, либо else)
@@ -301,11 +444,32 @@ public:
         instructions_.push_back(std::move(stmt));
     }
 
-    // Последовательно выполняет добавленные инструкции. Возвращает None
+    // Заменяет count инструкций, начиная с first, инструкциями statements
+    void Splice(size_t first, size_t count, std::vector<std::unique_ptr<Statement>> statements);
+
+    // Заменяет инструкцию с номером index
+    void ReplaceStatement(size_t index, std::unique_ptr<Statement> stmt) {
+        instructions_.at(index) = std::move(stmt);
+    }
+
+    [[nodiscard]] size_t GetStatementCount() const {
+        return instructions_.size();
+    }
+
+    // Последовательно выполняет добавленные инструкции. Возвращает None, а если одна из них
+    // выполнила return — прекращает выполнение и возвращает значение return
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+    [[nodiscard]] const StatementList& GetStatements() const {
+        return instructions_;
+    }
+
+    void Accept(StatementVisitor& visitor) const override {
+        visitor.Visit(*this);
+    }
+
 private:
-    std::vector<std::unique_ptr<Statement>> instructions_;
+    StatementList instructions_{runtime::CurrentResource()};
 
     template<typename T0,typename... Args>
     void FillArgs(T0&& first_arg,Args&&... args){
@@ -325,6 +489,14 @@ public:
     // Если внутри body была выполнена инструкция return, возвращает результат return
     // В противном случае возвращает None
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    [[nodiscard]] const Statement& GetBody() const {
+        return *body_;
+    }
+
+    void Accept(StatementVisitor& visitor) const override {
+        visitor.Visit(*this);
+    }
 private:
     std::unique_ptr<Statement> body_;
 };
@@ -338,7 +510,17 @@ public:
 
     // Останавливает выполнение текущего метода. После выполнения инструкции return метод,
     // внутри которого она была исполнена, должен вернуть результат вычисления выражения statement.
+    // Возвращает значение statement и отмечает возврат в context: объемлющие инструкции
+    // передают это значение наверх, не выполняя оставшихся инструкций, до тела метода
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    [[nodiscard]] const Statement& GetStatement() const {
+        return *statement_;
+    }
+
+    void Accept(StatementVisitor& visitor) const override {
+        visitor.Visit(*this);
+    }
 private:
     std::unique_ptr<Statement> statement_;
 };
@@ -352,8 +534,18 @@ public:
     // Создаёт внутри closure новый объект, совпадающий с именем класса и значением, переданным в
     // конструктор
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    // Гарантируется, что ObjectHolder содержит объект типа runtime::Class
+    [[nodiscard]] const runtime::ObjectHolder& GetClass() const {
+        return cls_;
+    }
+
+    void Accept(StatementVisitor& visitor) const override {
+        visitor.Visit(*this);
+    }
 private:
     runtime::ObjectHolder cls_;
+    symbols::Symbol name_;
 };
 
 // Инструкция if <condition> <if_body> else <else_body>
@@ -364,33 +556,27 @@ public:
            std::unique_ptr<Statement> else_body);
 
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-private:
-    std::unique_ptr<Statement> condition_;
-    std::unique_ptr<Statement> if_body_;
-    std::unique_ptr<Statement> else_body_;
 
-    template<typename ObjPtr>
-    runtime::ObjectHolder Exec(const ObjPtr& obj_ptr,runtime::Closure& closure, runtime::Context& context){
-        if(obj_ptr->GetValue()){
-            return if_body_->Execute(closure,context);
-        }else if(else_body_){
-            return else_body_->Execute(closure,context);
-        }
-        return runtime::ObjectHolder::None();
+    [[nodiscard]] const Statement& GetCondition() const {
+        return *condition_;
     }
 
-    template<typename StrPtr>
-    runtime::ObjectHolder ExecIfString(const StrPtr& obj_ptr,runtime::Closure& closure, runtime::Context& context){
-        const std::string_view result = obj_ptr->GetValue();
+    [[nodiscard]] const Statement& GetIfBody() const {
+        return *if_body_;
+    }
 
-        if(result.size()){
-            return if_body_->Execute(closure,context);
-        }else if(else_body_){
-            return else_body_->Execute(closure,context);
-        }
-        return runtime::ObjectHolder::None();
+    // Может вернуть nullptr, если ветка else отсутствует
+    [[nodiscard]] const Statement* GetElseBody() const {
+        return else_body_.get();
     }
 
+    void Accept(StatementVisitor& visitor) const override {
+        visitor.Visit(*this);
+    }
+private:
+    std::unique_ptr<Statement> condition_;
+    std::unique_ptr<Statement> if_body_;
+    std::unique_ptr<Statement> else_body_;
 };
 
 // Операция сравнения
@@ -399,14 +585,40 @@ public:
     // Comparator задаёт функцию, выполняющую сравнение значений аргументов
     using Comparator = std::function<bool(const runtime::ObjectHolder&,
     const runtime::ObjectHolder&, runtime::Context&)>;
+    // CachedComparator — то же сравнение, выполняемое через кеши методов одного места сравнения
+    using CachedComparator = bool (runtime::ComparisonCaches::*)(const runtime::ObjectHolder&,
+    const runtime::ObjectHolder&, runtime::Context&);
+
+    // Возвращает метод ComparisonCaches, соответствующий функции сравнения из runtime,
+    // или nullptr, если cmp — другая функция
+    static CachedComparator FindCachedComparator(const Comparator& cmp);
 
     Comparison(Comparator cmp, std::unique_ptr<Statement> lhs, std::unique_ptr<Statement> rhs);
 
     // Вычисляет значение выражений lhs и rhs и возвращает результат работы comparator,
     // приведённый к типу runtime::Bool
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    [[nodiscard]] const Comparator& GetComparator() const {
+        return cmp_;
+    }
+
+    [[nodiscard]] CachedComparator GetCachedComparator() const {
+        return cached_cmp_;
+    }
+
+    void Accept(StatementVisitor& visitor) const override {
+        visitor.Visit(*this);
+    }
 private:
     Comparator cmp_;
+    CachedComparator cached_cmp_;
+    runtime::ComparisonCaches caches_;
 };
 
+// Приводит значение условия if, а также аргумента or и and, к логическому типу:
+// число и Bool — по значению, строка — по непустоте, экземпляр класса — True, None — False.
+// Для остальных значений выбрасывает runtime_error
+bool IsConditionTrue(const runtime::ObjectHolder& value);
+
 }  // namespace ast
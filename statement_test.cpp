@@ -65,6 +65,29 @@ void TestStringConst() {
     ASSERT(context.output.str().empty());
 }
 
+void TestConstantsOutliveTree() {
+    runtime::DummyContext context;
+    Closure empty;
+
+    ObjectHolder number;
+    ObjectHolder first;
+    ObjectHolder second;
+    {
+        auto num = make_unique<NumericConst>(runtime::Number(42));
+        auto str = make_unique<StringConst>(runtime::String("constant"s));
+        number = num->Execute(empty, context);
+        first = str->Execute(empty, context);
+        second = str->Execute(empty, context);
+        // Строка создаётся один раз и разделяется всеми выполнениями
+        ASSERT(first.Get() == second.Get());
+        ASSERT(first.Get() == str->GetConstant().Get());
+    }
+
+    // Значения констант остаются действительными после удаления дерева
+    ASSERT_EQUAL(number.TryAs<runtime::Number>()->GetValue(), 42);
+    ASSERT_EQUAL(first.TryAs<runtime::String>()->GetValue(), "constant"s);
+}
+
 void TestVariable() {
     runtime::DummyContext context;
 
@@ -451,11 +474,33 @@ void TestNot() {
     test_not(false);
 }
 
+void TestResultsAreImmediate() {
+    // Числа и логические значения, которые возвращают операции, хранятся в самом ObjectHolder
+    // и не выделяют память
+    auto is_immediate = [](const ObjectHolder& holder) {
+        const auto* begin = reinterpret_cast<const char*>(&holder);
+        const auto* stored = reinterpret_cast<const char*>(holder.Get());
+        return stored >= begin && stored < begin + sizeof(ObjectHolder);
+    };
+    Closure closure;
+    runtime::DummyContext context;
+
+    ASSERT(is_immediate(Add(make_unique<NumericConst>(1), make_unique<NumericConst>(2)).Execute(closure, context)));
+    ASSERT(is_immediate(Sub(make_unique<NumericConst>(1), make_unique<NumericConst>(2)).Execute(closure, context)));
+    ASSERT(is_immediate(Not(make_unique<BoolConst>(true)).Execute(closure, context)));
+    const ObjectHolder less = Comparison(runtime::Less, make_unique<NumericConst>(1), make_unique<NumericConst>(2))
+                                  .Execute(closure, context);
+    ASSERT(is_immediate(less));
+    ASSERT(less.TryAs<runtime::Bool>()->GetValue());
+    ASSERT(!ObjectHolder::None());
+}
+
 }  // namespace
 
 void RunUnitTests(TestRunner& tr) {
     RUN_TEST(tr, ast::TestNumericConst);
     RUN_TEST(tr, ast::TestStringConst);
+    RUN_TEST(tr, ast::TestConstantsOutliveTree);
     RUN_TEST(tr, ast::TestVariable);
     RUN_TEST(tr, ast::TestAssignment);
     RUN_TEST(tr, ast::TestFieldAssignment);
@@ -474,6 +519,7 @@ void RunUnitTests(TestRunner& tr) {
     RUN_TEST(tr, ast::TestOr);
     RUN_TEST(tr, ast::TestAnd);
     RUN_TEST(tr, ast::TestNot);
+    RUN_TEST(tr, ast::TestResultsAreImmediate);
 }
 
 }  // namespace ast
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "runtime.h"
+
+#include <memory_resource>
+#include <vector>
+
+namespace ast {
+
+using Statement = runtime::Executable;
+// Список инструкций узла. Память под него берётся из той же арены, что и под сам узел
+using StatementList = std::pmr::vector<std::unique_ptr<Statement>>;
+using SymbolList = std::pmr::vector<symbols::Symbol>;
+
+template <typename T>
+class ValueStatement;
+
+using NumericConst = ValueStatement<runtime::Number>;
+using StringConst = ValueStatement<runtime::String>;
+using BoolConst = ValueStatement<runtime::Bool>;
+
+class VariableValue;
+class Assignment;
+class FieldAssignment;
+class None;
+class Print;
+class MethodCall;
+class NewInstance;
+class Stringify;
+class Add;
+class Sub;
+class Mult;
+class Div;
+class Or;
+class And;
+class Not;
+class Compound;
+class MethodBody;
+class Return;
+class ClassDefinition;
+class IfElse;
+class Comparison;
+
+// Обходчик дерева программы. Каждый узел вызывает перегрузку Visit для своего типа,
+// инструкции, не входящие в ast (например, написанные вручную в тестах), — VisitOpaque
+class StatementVisitor {
+public:
+    virtual void Visit(const NumericConst& node) = 0;
+    virtual void Visit(const StringConst& node) = 0;
+    virtual void Visit(const BoolConst& node) = 0;
+    virtual void Visit(const VariableValue& node) = 0;
+    virtual void Visit(const Assignment& node) = 0;
+    virtual void Visit(const FieldAssignment& node) = 0;
+    virtual void Visit(const None& node) = 0;
+    virtual void Visit(const Print& node) = 0;
+    virtual void Visit(const MethodCall& node) = 0;
+    virtual void Visit(const NewInstance& node) = 0;
+    virtual void Visit(const Stringify& node) = 0;
+    virtual void Visit(const Add& node) = 0;
+    virtual void Visit(const Sub& node) = 0;
+    virtual void Visit(const Mult& node) = 0;
+    virtual void Visit(const Div& node) = 0;
+    virtual void Visit(const Or& node) = 0;
+    virtual void Visit(const And& node) = 0;
+    virtual void Visit(const Not& node) = 0;
+    virtual void Visit(const Compound& node) = 0;
+    virtual void Visit(const MethodBody& node) = 0;
+    virtual void Visit(const Return& node) = 0;
+    virtual void Visit(const ClassDefinition& node) = 0;
+    virtual void Visit(const IfElse& node) = 0;
+    virtual void Visit(const Comparison& node) = 0;
+    virtual void VisitOpaque(const Statement& node) = 0;
+
+protected:
+    ~StatementVisitor() = default;
+};
+
+}  // namespace ast
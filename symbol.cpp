@@ -0,0 +1,56 @@
+#include "symbol.h"
+
+#include <ostream>
+
+using namespace std;
+
+namespace symbols
+{
+
+    SymbolTable &SymbolTable::Instance(){
+        static SymbolTable table;
+        return table;
+    }
+
+    SymbolTable::SymbolTable(){
+        // Номер 0 зарезервирован за пустым именем, его возвращает Symbol()
+        Intern(""sv);
+    }
+
+    uint32_t SymbolTable::Intern(std::string_view name){
+        std::lock_guard guard(mutex_);
+        if (const auto it = ids_.find(name); it != ids_.end()){
+            return it->second;
+        }
+        const auto id = static_cast<uint32_t>(names_.size());
+        const std::string &stored = names_.emplace_back(name);
+        ids_.emplace(stored, id);
+        return id;
+    }
+
+    const std::string &SymbolTable::GetName(uint32_t id) const{
+        std::lock_guard guard(mutex_);
+        return names_.at(id);
+    }
+
+    Symbol::Symbol(std::string_view name)
+        : id_(SymbolTable::Instance().Intern(name)){
+    }
+
+    Symbol::Symbol(const std::string &name)
+        : Symbol(std::string_view(name)){
+    }
+
+    Symbol::Symbol(const char *name)
+        : Symbol(std::string_view(name)){
+    }
+
+    const std::string &Symbol::GetName() const{
+        return SymbolTable::Instance().GetName(id_);
+    }
+
+    std::ostream &operator<<(std::ostream &os, Symbol symbol){
+        return os << symbol.GetName();
+    }
+
+} // namespace symbols
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace symbols
+{
+
+    // Глобальная таблица имён. Каждое имя хранится в единственном экземпляре
+    // и получает постоянный 32-битный номер
+    class SymbolTable{
+    public:
+        static SymbolTable &Instance();
+
+        // Возвращает номер имени name, добавляя его в таблицу при первом обращении
+        uint32_t Intern(std::string_view name);
+
+        // Возвращает имя по его номеру
+        [[nodiscard]] const std::string &GetName(uint32_t id) const;
+
+    private:
+        SymbolTable();
+
+        mutable std::mutex mutex_;
+        // deque не перемещает строки при добавлении, поэтому ключи ids_ остаются валидными
+        std::deque<std::string> names_;
+        std::unordered_map<std::string_view, uint32_t> ids_;
+    };
+
+    // Интернированное имя (идентификатор, имя метода, поля или переменной).
+    // Сравнение и хеширование сводятся к операциям над номером имени
+    class Symbol{
+    public:
+        // Пустое имя
+        Symbol() = default;
+
+        Symbol(std::string_view name); // NOLINT(google-explicit-constructor,hicpp-explicit-conversions)
+        Symbol(const std::string &name); // NOLINT(google-explicit-constructor,hicpp-explicit-conversions)
+        Symbol(const char *name); // NOLINT(google-explicit-constructor,hicpp-explicit-conversions)
+
+        // Восстанавливает имя по номеру, ранее полученному из GetId()
+        static Symbol FromId(uint32_t id){
+            Symbol symbol;
+            symbol.id_ = id;
+            return symbol;
+        }
+
+        [[nodiscard]] const std::string &GetName() const;
+
+        [[nodiscard]] uint32_t GetId() const{
+            return id_;
+        }
+
+    private:
+        uint32_t id_ = 0;
+    };
+
+    inline bool operator==(Symbol lhs, Symbol rhs){
+        return lhs.GetId() == rhs.GetId();
+    }
+
+    inline bool operator!=(Symbol lhs, Symbol rhs){
+        return !(lhs == rhs);
+    }
+
+    std::ostream &operator<<(std::ostream &os, Symbol symbol);
+
+} // namespace symbols
+
+namespace std
+{
+    template <>
+    struct hash<symbols::Symbol>{
+        size_t operator()(symbols::Symbol symbol) const noexcept{
+            return symbol.GetId();
+        }
+    };
+} // namespace std